@@ -1,10 +1,7 @@
 import sys
 import numpy as np
-from sklearn.metrics import silhouette_score
 import symnmf
 
-from kmeans import k_means, get_data
-
 
 def read_input(file_name):
     """Reads the input file and returns the data as a NumPy array. Params: file_name - name of the file to read. Ret: NumPy array."""
@@ -40,19 +37,19 @@ def main():
         # Perform SymNMF clustering
         symnmf_labels = perform_symnmf_clustering(X, k)
         
-        # Perform KMeans clustering
-        X_not_np = get_data(file_name)
-        kmeans_labels = k_means(X_not_np, k)
-
-        if len(set(symnmf_labels)) > 1:
-            print(f"nmf: {silhouette_score(X, symnmf_labels):.4f}")
-        else:
-            print(f"nmf: Score is undefined if only one cluster is found")
-        
-        if len(set(kmeans_labels)) > 1:
-            print(f"kmeans: {silhouette_score(X, kmeans_labels):.4f}")
-        else:
-            print(f"kmeans: Score is undefined if only one cluster is found")
+        # Perform KMeans clustering (kmeans.k_means, compiled)
+        kmeans_labels = symnmf.kmeans(X, k)
+
+        # The clusterings that can be scored (more than one cluster), in one pass over the pairwise distances
+        clusterings = [("nmf", symnmf_labels), ("kmeans", kmeans_labels)]
+        scorable = [labels for _, labels in clusterings if len(set(labels)) > 1]
+        scores = iter(symnmf.silhouette(X, scorable) if scorable else [])
+
+        for name, labels in clusterings:
+            if len(set(labels)) > 1:
+                print(f"{name}: {next(scores):.4f}")
+            else:
+                print(f"{name}: Score is undefined if only one cluster is found")
             
     except ValueError:
         print("An Error Has Occurred")
@@ -1,10 +1,15 @@
+import os
 from setuptools import setup, Extension
 import numpy as np
 
 symnmf_module = Extension(
     'symnmf',
     sources=['symnmfmodule.c', 'symnmf.c'],
-    include_dirs=[np.get_include()] # need it for processing the numpy array given
+    depends=['symnmf.h', 'symnmf_kernels.h', 'symnmfmodule_bridges.h'], # type-generic sources included per element type
+    include_dirs=[np.get_include()], # need it for processing the numpy array given
+    define_macros=[('SYMNMF_STATS', None)] if os.environ.get('SYMNMF_STATS') == '1' else [], # the stats=True counters
+    extra_compile_args=['-fopenmp'], # parallel kernels in symnmf.c
+    extra_link_args=['-fopenmp']
 )
 
 setup(
@@ -12,4 +17,4 @@ setup(
     version='1.0',
     description='Python-C extension for Symmetric Non-negative Matrix Factorization',
     ext_modules=[symnmf_module],
-)
\ No newline at end of file
+)
@@ -4,6 +4,20 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#define THREAD_COUNT() omp_get_max_threads()
+#define THREAD_ID() omp_get_thread_num()
+#else
+#define THREAD_COUNT() 1
+#define THREAD_ID() 0
+#endif
 
 /*Error message helper. Params: quit-whether to also exit. Ret: None*/
 void printError(char quit){
@@ -12,34 +26,234 @@ void printError(char quit){
         exit(1);
 }
 
-/* Helper function to allocate a 2D array. Params: rows&cols - size. Ret: matrix, NULL on failure.*/
-double** allocate_matrix(int rows, int cols) {
-    int i, j;
-    double** matrix = (double**)malloc(rows * sizeof(double*));
+/* Store one upper triangle similarity value (i < j) into whichever outputs were requested.*/
+#define STORE_SIMILARITY(full, packed, local, i, j, value) do { \
+        if (full) MAT(full, i, j) = MAT(full, j, i) = (value); \
+        if (packed) PACKED(packed, i, j) = (value); \
+        if (local) { (local)[i] += (value); (local)[j] += (value); } \
+    } while (0)
 
-    if (!matrix) return NULL;
-    for (i = 0; i < rows; i++) {
-        matrix[i] = (double*)malloc(cols * sizeof(double));
-        if (!matrix[i]) {
-            for (j = 0; j < i; j++) 
-                free(matrix[j]); /* Free the previous rows*/
-            free(matrix);
-            return NULL;
+static SymnmfStats* stats_sink = NULL; /* Where the calling thread's counters go, NULL for nowhere*/
+#pragma omp threadprivate(stats_sink)
+
+/* Zero a set of counters. Params: stats - the counters. Ret: None.*/
+void stats_init(SymnmfStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->current = -1;
+}
+
+/* Send the calling thread's counters to stats (NULL: nowhere) until the next stats_attach. Parallel regions that
+run instrumented kernels on their workers pass it on with copyin(stats_sink). Params: stats - the counters.
+Ret: the previously attached ones.*/
+SymnmfStats* stats_attach(SymnmfStats* stats) {
+    SymnmfStats* previous = stats_sink;
+    stats_sink = stats;
+    return previous;
+}
+
+#ifdef SYMNMF_STATS
+static double stats_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* Open a phase: its clock runs while any thread of the call is inside it, and flops and bytes go to the innermost
+open phase. Params: phase - STAT_ index. Ret: None.*/
+void stats_begin(int phase) {
+    SymnmfStats* stats = stats_sink;
+    double now;
+    if (!stats) return;
+    now = stats_clock();
+#pragma omp critical(symnmf_stats)
+    if (stats->depth[phase]++ == 0) {
+        stats->started[phase] = now;
+        stats->parent[phase] = stats->current;
+        stats->current = phase;
+    }
+}
+
+/* Close a phase opened by stats_begin. Params: phase - STAT_ index. Ret: None.*/
+void stats_end(int phase) {
+    SymnmfStats* stats = stats_sink;
+    double now;
+    if (!stats) return;
+    now = stats_clock();
+#pragma omp critical(symnmf_stats)
+    if (--stats->depth[phase] == 0) {
+        stats->seconds[phase] += now - stats->started[phase];
+        stats->current = stats->parent[phase];
+    }
+}
+
+void stats_flops(double count) {
+    SymnmfStats* stats = stats_sink;
+    if (!stats) return;
+#pragma omp critical(symnmf_stats)
+    if (stats->current >= 0) stats->flops[stats->current] += count;
+}
+
+void stats_bytes(double count) {
+    SymnmfStats* stats = stats_sink;
+    if (!stats) return;
+#pragma omp critical(symnmf_stats)
+    if (stats->current >= 0) stats->bytes[stats->current] += count;
+}
+
+void stats_iteration(double delta) {
+    SymnmfStats* stats = stats_sink;
+    if (!stats) return;
+#pragma omp critical(symnmf_stats)
+    {
+        if (stats->deltas_recorded < STATS_HISTORY) stats->deltas[stats->deltas_recorded++] = delta;
+        stats->iterations++;
+    }
+}
+
+/* The --stats report on stderr. Params: stats - the counters of the run. Ret: None.*/
+static void stats_print(const SymnmfStats* stats) {
+    static const char* names[] = STAT_PHASE_NAMES;
+    int phase;
+
+    fprintf(stderr, "%-12s %12s %12s %14s\n", "phase", "seconds", "GFLOP/s", "bytes");
+    for (phase = 0; phase < STAT_PHASES; phase++)
+        fprintf(stderr, "%-12s %12.6f %12.3f %14.0f\n", names[phase], stats->seconds[phase],
+                stats->seconds[phase] > 0 ? stats->flops[phase] / stats->seconds[phase] * 1e-9 : 0.0,
+                stats->bytes[phase]);
+    fprintf(stderr, "symnmf updates: %ld", stats->iterations);
+    if (stats->deltas_recorded)
+        fprintf(stderr, ", last ||dH||^2 %g", stats->deltas[stats->deltas_recorded - 1]);
+    fprintf(stderr, "\n");
+}
+#else
+static void stats_print(const SymnmfStats* stats) {
+    (void)stats;
+    fprintf(stderr, "symnmf: built without statistics, rebuild with make STATS=1\n");
+}
+#endif
+
+/* MT19937 drawn like NumPy's legacy np.random after np.random.seed(seed), so the multi-start runs start
+from exactly the H symnmf.py's initialize_H would give them.*/
+#define MT_STATE_SIZE 624
+typedef struct {
+    unsigned long state[MT_STATE_SIZE];
+    int index;
+} MersenneTwister;
+
+static void mt_seed(MersenneTwister* mt, unsigned long seed) {
+    int i;
+    mt->state[0] = seed & 0xffffffffUL;
+    for (i = 1; i < MT_STATE_SIZE; i++)
+        mt->state[i] = (1812433253UL * (mt->state[i - 1] ^ (mt->state[i - 1] >> 30)) + i) & 0xffffffffUL;
+    mt->index = MT_STATE_SIZE;
+}
+
+static unsigned long mt_next(MersenneTwister* mt) {
+    unsigned long y;
+    if (mt->index >= MT_STATE_SIZE) { /* Regenerate the whole state */
+        int i;
+        for (i = 0; i < MT_STATE_SIZE; i++) {
+            y = (mt->state[i] & 0x80000000UL) | (mt->state[(i + 1) % MT_STATE_SIZE] & 0x7fffffffUL);
+            mt->state[i] = mt->state[(i + 397) % MT_STATE_SIZE] ^ (y >> 1) ^ ((y & 1) ? 0x9908b0dfUL : 0);
         }
+        mt->index = 0;
+    }
+    y = mt->state[mt->index++];
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680UL;
+    y ^= (y << 15) & 0xefc60000UL;
+    return (y ^ (y >> 18)) & 0xffffffffUL;
+}
+
+/* np.random.random_sample(): uniform in [0, 1) with 53 random bits.*/
+static double mt_random_sample(MersenneTwister* mt) {
+    unsigned long a = mt_next(mt) >> 5, b = mt_next(mt) >> 6;
+    return (a * 67108864.0 + b) / 9007199254740992.0;
+}
+
+/* The dense kernels, instantiated once per element type from symnmf_kernels.h.*/
+#define REAL double
+#define MATRIX Matrix
+#define PACKED_MATRIX PackedMatrix
+#define EXP exp
+#define SQRT sqrt
+#define FN(name) name
+#include "symnmf_kernels.h"
+
+#define REAL float
+#define MATRIX FloatMatrix
+#define PACKED_MATRIX FloatPackedMatrix
+#define EXP expf
+#define SQRT sqrtf
+#define FN(name) name##_f
+#include "symnmf_kernels.h"
+
+/* Build a double** view over a Matrix for code that still wants row pointers.
+Params: matrix - the matrix. Ret: row pointer array (free() it, not the rows), NULL on failure.*/
+double** matrix_row_pointers(const Matrix* matrix) {
+    int i;
+    double** rows = (double**)malloc((matrix->rows ? matrix->rows : 1) * sizeof(double*));
+    if (!rows) return NULL;
+    for (i = 0; i < matrix->rows; i++)
+        rows[i] = MAT_ROW(matrix, i);
+    return rows;
+}
+
+/* Compatibility shim: 2D array whose rows point into one contiguous aligned block.
+Params: rows&cols - size. Ret: matrix, NULL on failure.*/
+double** allocate_matrix(int rows, int cols) {
+    Matrix* block = create_matrix(rows, cols);
+    double** matrix;
+
+    if (!block) return NULL;
+    matrix = matrix_row_pointers(block);
+    if (!matrix) {
+        destroy_matrix(block);
+        return NULL;
     }
+    if (rows == 0) /* Keep the block reachable so free_matrix can release it*/
+        matrix[0] = block->data;
+    block->owner = 0; /* The block is now owned through matrix[0] */
+    destroy_matrix(block);
     return matrix;
 }
 
-/* Helper function to free a 2D array. Params: matrix - the matrix to free, rows - the num of rows. Ret: None.*/
+/* Free a 2D array made by allocate_matrix. Params: matrix - the matrix to free, rows - unused
+(kept for the old signature). Ret: None.*/
 void free_matrix(double** matrix, int rows) {
-    int i;
+    (void)rows;
     if(!matrix) return; /* Check if matrix is NULL*/
-    for (i = 0; i < rows; i++)
-        free(matrix[i]);
-    
+    free(matrix[0]); /* All rows share the block that starts at row 0*/
     free(matrix);
 }
 
+/* Allocate the packed upper triangle of a symmetric n x n matrix. Params: n - size.
+Ret: packed matrix, NULL on failure.*/
+PackedMatrix* create_packed_matrix(int n) {
+    PackedMatrix* packed;
+    void* data = NULL;
+    size_t bytes = PACKED_SIZE(n) * sizeof(double);
+
+    if (n < 0) return NULL;
+    packed = (PackedMatrix*)malloc(sizeof(PackedMatrix));
+    if (!packed) return NULL;
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, bytes ? bytes : sizeof(double))) {
+        free(packed);
+        return NULL;
+    }
+    packed->data = (double*)data;
+    packed->n = n;
+    STATS_BYTES(bytes);
+    return packed;
+}
+
+/* Free a packed matrix. Params: packed - may be NULL. Ret: None.*/
+void destroy_packed_matrix(PackedMatrix* packed) {
+    if (!packed) return;
+    free(packed->data);
+    free(packed);
+}
+
 /* Helper function to compute the squared Euclidean distance.
 Params: a - first array, b - second array,d - dimension. Ret: distance.*/
 double squared_euclidean_distance(const double* a, const double* b, int d) {
@@ -53,278 +267,1173 @@ double squared_euclidean_distance(const double* a, const double* b, int d) {
     return sum;
 }
 
-/* Compute the similarity matrix. Params: data - input matrix,
-n - number of vectors, d - dimension. Ret: similarity matrix, NULL on failure.*/
-double** compute_similarity_matrix(double** data, int n, int d) {
-    int i, j;
-    double** similarity = allocate_matrix(n, n);
-    if (!similarity) return NULL;
+/* Compute the similarity matrix. Params: data - input matrix (n vectors of dimension d).
+Ret: n x n similarity matrix, NULL on failure.*/
+Matrix* compute_similarity_matrix(const Matrix* data) {
+    Matrix* similarity;
+    STATS_BEGIN(STAT_SIMILARITY); /* The n x n storage counts towards the phase*/
+    similarity = create_matrix(data->rows, data->rows);
+    if (similarity && compute_similarity(data, similarity, NULL, NULL)) {
+        destroy_matrix(similarity);
+        similarity = NULL;
+    }
+    STATS_END(STAT_SIMILARITY);
+    return similarity;
+}
 
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            if (i == j) 
-                similarity[i][j] = 0.0;
-            else {
-                double dist = squared_euclidean_distance(data[i], data[j], d);
-                similarity[i][j] = exp(-dist/2);
-            }
-        }
+/* Compute the packed (upper triangle) similarity matrix, half the memory of the full one.
+Params: data - input matrix, degrees - n row sums or NULL. Ret: packed matrix, NULL on failure.*/
+PackedMatrix* compute_packed_similarity(const Matrix* data, double* degrees) {
+    PackedMatrix* similarity;
+    STATS_BEGIN(STAT_SIMILARITY);
+    similarity = create_packed_matrix(data->rows);
+    if (similarity && compute_similarity(data, NULL, similarity, degrees)) {
+        destroy_packed_matrix(similarity);
+        similarity = NULL;
     }
+    STATS_END(STAT_SIMILARITY);
     return similarity;
 }
 
-/* Compute the diagonal degree matrix. Params: similarity - the similarity matrix,
-n - size of matrix. Ret: the eigenvalues (diagonal values), NULL on failure.*/
-double* compute_degree_array(double** similarity, int n) {
-    double* degrees = (double*)malloc(n * sizeof(double));
-    int i, j;
+/* Compute the diagonal degree matrix. Params: similarity - the n x n similarity matrix.
+Ret: the eigenvalues (diagonal values), NULL on failure.*/
+double* compute_degree_array(const Matrix* similarity) {
+    int i, j, n = similarity->rows;
+    double* degrees = (double*)malloc((n ? n : 1) * sizeof(double));
     if (!degrees) return NULL;
 
+    STATS_BEGIN(STAT_DEGREE);
     for (i = 0; i < n; i++) {
+        const double* row = MAT_ROW(similarity, i);
         degrees[i] = 0.0;
         for (j = 0; j < n; j++)
-            degrees[i] += similarity[i][j];
+            degrees[i] += row[j];
     }
+    STATS_FLOPS((double)n * n);
+    STATS_END(STAT_DEGREE);
 
     return degrees;
 }
 
-/* Compute the normalized similarity matrix. Params: similarity - the similarity matrix,
-n - size of matrix. Ret: the normalized similarity matrix (diagonal values), NULL on failure.*/
-double** compute_normalized_similarity(double** similarity, int n) {
-    double* degrees = compute_degree_array(similarity, n);
-    int i, j;
-    double** normalized = allocate_matrix(n, n);
+
+/* Compute the normalized similarity matrix into a new matrix. Params: similarity - the n x n similarity matrix.
+Ret: the normalized similarity matrix, NULL on failure.*/
+Matrix* compute_normalized_similarity(const Matrix* similarity) {
+    int i, n = similarity->rows;
+    double* degrees = compute_degree_array(similarity);
+    Matrix* normalized = create_matrix(n, n);
     
     if (!degrees || !normalized) {
-        if(normalized) free_matrix(normalized, n);
-        if(degrees) free(degrees);
+        destroy_matrix(normalized);
+        free(degrees);
         return NULL;
     }
 
-    for (i = 0; i < n; i++) {
-        for (j = 0; j < n; j++) {
-            if (degrees[i] > 0 && degrees[j] > 0)
-                normalized[i][j] = similarity[i][j] / sqrt(degrees[i] * degrees[j]);
-            else
-                normalized[i][j] = 0.0;
-        }
+    for (i = 0; i < n; i++)
+        memcpy(MAT_ROW(normalized, i), MAT_ROW(similarity, i), n * sizeof(double));
+    if (normalize_similarity(normalized, NULL, degrees)) {
+        destroy_matrix(normalized);
+        normalized = NULL;
     }
 
     free(degrees);
     return normalized;
 }
 
-/* Computes the product of matrix A and its transposed A^t (In place). Params: A - the matrix,
-AxAt - matrix to hold the result, n - size of matrix. Ret: NONE.*/
-void multiply_matrix_by_its_transposed(double** A, double** AxAt, int n, int k) {
-    int i, j, l;
+/* Allocate a CSR matrix. Params: rows&cols - size, nnz - number of stored entries.
+Ret: sparse matrix with row_start[0] = 0, NULL on failure.*/
+SparseMatrix* create_sparse_matrix(int rows, int cols, size_t nnz) {
+    SparseMatrix* sparse = (SparseMatrix*)malloc(sizeof(SparseMatrix));
+    if (!sparse) return NULL;
+    sparse->rows = rows;
+    sparse->cols = cols;
+    sparse->owner = 1;
+    sparse->values = (double*)malloc((nnz ? nnz : 1) * sizeof(double));
+    sparse->col_index = (int*)malloc((nnz ? nnz : 1) * sizeof(int));
+    sparse->row_start = (size_t*)malloc((rows + 1) * sizeof(size_t));
+    if (!sparse->values || !sparse->col_index || !sparse->row_start) {
+        destroy_sparse_matrix(sparse);
+        return NULL;
+    }
+    sparse->row_start[0] = 0;
+    STATS_BYTES(nnz * (sizeof(double) + sizeof(int)) + (rows + 1) * sizeof(size_t));
+    return sparse;
+}
+
+/* Free a CSR matrix. Params: sparse - may be NULL. Ret: None.*/
+void destroy_sparse_matrix(SparseMatrix* sparse) {
+    if (!sparse) return;
+    if (sparse->owner) {
+        free(sparse->values);
+        free(sparse->col_index);
+        free(sparse->row_start);
+    }
+    free(sparse);
+}
+
+/* One stored entry while the symmetric graph is assembled.*/
+typedef struct {
+    int col;
+    double value;
+} SparseEntry;
+
+/* qsort comparator ordering entries of a row by column.*/
+static int compare_sparse_entries(const void* a, const void* b) {
+    int ca = ((const SparseEntry*)a)->col, cb = ((const SparseEntry*)b)->col;
+    return (ca > cb) - (ca < cb);
+}
+
+/* Sift a new candidate into a max-heap (by distance) holding the closest neighbors found so far.
+Params: dist&idx - heap arrays, size - current size, capacity - heap capacity, d&j - candidate. Ret: new size.*/
+static int push_neighbor(double* dist, int* idx, int size, int capacity, double d, int j) {
+    int pos, child;
+    if (size == capacity) { /* Full: replace the farthest one if the candidate is closer*/
+        if (d >= dist[0]) return size;
+        pos = 0;
+        for (;;) { /* Sift down from the root*/
+            child = 2 * pos + 1;
+            if (child >= size) break;
+            if (child + 1 < size && dist[child + 1] > dist[child]) child++;
+            if (dist[child] <= d) break;
+            dist[pos] = dist[child];
+            idx[pos] = idx[child];
+            pos = child;
+        }
+    } else { /* Sift up from the new leaf*/
+        pos = size++;
+        while (pos > 0 && dist[(pos - 1) / 2] < d) {
+            dist[pos] = dist[(pos - 1) / 2];
+            idx[pos] = idx[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+    }
+    dist[pos] = d;
+    idx[pos] = j;
+    return size;
+}
+
+/* Turn the directed neighbor lists into a symmetric CSR graph: (i,j) is kept if j is a neighbor of i
+or i is a neighbor of j. Params: edges&values&counts - neighbors of row i at [i*width, i*width+counts[i]),
+n - vectors, width - slots per row, degrees - row sums or NULL. Ret: sparse matrix, NULL on failure.*/
+static SparseMatrix* symmetrize_neighbors(const int* edges, const double* values, const int* counts,
+                                          int n, int width, double* degrees) {
+    int i, t;
+    size_t p, q, nnz = 0;
+    SparseMatrix* sparse = NULL;
+    size_t* start = (size_t*)calloc(n + 1, sizeof(size_t));
+    size_t* cursor = (size_t*)malloc((n ? n : 1) * sizeof(size_t));
+    SparseEntry* entries;
+
+    for (i = 0; i < n && start; i++) { /* Row i gets its own neighbors plus every row pointing at it*/
+        start[i + 1] += counts[i];
+        for (t = 0; t < counts[i]; t++)
+            start[edges[(size_t)i * width + t] + 1]++;
+    }
+    for (i = 0; i < n && start; i++)
+        start[i + 1] += start[i];
+    entries = start ? (SparseEntry*)malloc((start[n] ? start[n] : 1) * sizeof(SparseEntry)) : NULL;
+    if (!entries || !cursor) {
+        free(start);
+        free(cursor);
+        free(entries);
+        return NULL;
+    }
+
+    memcpy(cursor, start, n * sizeof(size_t));
+    for (i = 0; i < n; i++) {
+        for (t = 0; t < counts[i]; t++) {
+            int j = edges[(size_t)i * width + t];
+            double v = values[(size_t)i * width + t];
+            entries[cursor[i]].col = j;
+            entries[cursor[i]++].value = v;
+            entries[cursor[j]].col = i;
+            entries[cursor[j]++].value = v;
+        }
+    }
+
+#pragma omp parallel for private(p, q) reduction(+:nnz) schedule(dynamic, SIM_BLOCK)
+    for (i = 0; i < n; i++) { /* Sort each row and drop the pairs that were found from both ends*/
+        qsort(entries + start[i], start[i + 1] - start[i], sizeof(SparseEntry), compare_sparse_entries);
+        for (p = q = start[i]; p < start[i + 1]; p++)
+            if (q == start[i] || entries[q - 1].col != entries[p].col)
+                entries[q++] = entries[p];
+        cursor[i] = q - start[i]; /* Unique entries left in row i*/
+        nnz += cursor[i];
+    }
+
+    sparse = create_sparse_matrix(n, n, nnz);
+    if (sparse) {
+        for (i = 0; i < n; i++) {
+            size_t out = sparse->row_start[i];
+            if (degrees) degrees[i] = 0.0;
+            for (p = 0; p < cursor[i]; p++) {
+                sparse->col_index[out + p] = entries[start[i] + p].col;
+                sparse->values[out + p] = entries[start[i] + p].value;
+                if (degrees) degrees[i] += entries[start[i] + p].value;
+            }
+            sparse->row_start[i + 1] = out + cursor[i];
+        }
+    }
+    free(entries);
+    free(cursor);
+    free(start);
+    return sparse;
+}
+
+/* Compute a sparse similarity graph: every vector is linked to its `neighbors` nearest vectors and/or
+to all vectors closer than `radius`, with the same Gaussian weights as the dense matrix, symmetrized.
+Memory is O(n * neighbors) instead of O(n^2). Params: data - input matrix, neighbors - k of the k-NN
+graph (0 for a pure radius graph), radius - distance cutoff (0 for none), degrees - n row sums or NULL.
+Ret: symmetric CSR similarity matrix, NULL on failure.*/
+SparseMatrix* compute_sparse_similarity(const Matrix* data, int neighbors, double radius, double* degrees) {
+    int i, j, t, n = data->rows, d = data->cols, width, threads = THREAD_COUNT();
+    const double cutoff = radius > 0 ? radius * radius : -1; /* compared against squared distances*/
+    double *norms, *values, *heap_dist;
+    int *edges, *counts, *heap_idx;
+    SparseMatrix* sparse = NULL;
+
+    if (neighbors < 0 || radius < 0 || (neighbors == 0 && radius == 0)) return NULL;
+    if (neighbors > n - 1) neighbors = n - 1;
+    STATS_BEGIN(STAT_SIMILARITY);
+    width = neighbors ? neighbors : (n ? n - 1 : 0); /* Radius rows are compacted to their real size below*/
+    norms = (double*)malloc((n ? n : 1) * sizeof(double));
+    counts = (int*)calloc(n ? n : 1, sizeof(int));
+    heap_dist = (double*)malloc(((size_t)threads * neighbors + 1) * sizeof(double));
+    heap_idx = (int*)malloc(((size_t)threads * neighbors + 1) * sizeof(int));
+    if (!norms || !counts || !heap_dist || !heap_idx) {
+        free(norms); free(counts); free(heap_dist); free(heap_idx);
+        STATS_END(STAT_SIMILARITY);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        const double* row = MAT_ROW(data, i);
+        norms[i] = 0;
+        for (t = 0; t < d; t++)
+            norms[i] += row[t] * row[t];
+    }
+
+    if (!neighbors) { /* Radius graph: count each row first so the edge list is exactly nnz long*/
+#pragma omp parallel for private(j, t) schedule(dynamic, SIM_BLOCK)
+        for (i = 0; i < n; i++) {
+            const double* row_i = MAT_ROW(data, i);
+            for (j = 0; j < n; j++) {
+                const double* row_j = MAT_ROW(data, j);
+                double dot = 0;
+                for (t = 0; t < d; t++)
+                    dot += row_i[t] * row_j[t];
+                if (j != i && norms[i] + norms[j] - 2 * dot <= cutoff)
+                    counts[i]++;
+            }
+        }
+        width = 0;
+        for (i = 0; i < n; i++)
+            width = counts[i] > width ? counts[i] : width;
+        STATS_FLOPS(2.0 * n * n * d);
+    }
+    edges = (int*)malloc(((size_t)n * width + 1) * sizeof(int));
+    values = (double*)malloc(((size_t)n * width + 1) * sizeof(double));
+    if (!edges || !values) {
+        free(norms); free(counts); free(heap_dist); free(heap_idx); free(edges); free(values);
+        STATS_END(STAT_SIMILARITY);
+        return NULL;
+    }
+
+#pragma omp parallel private(j, t)
+    {
+        double* best_dist = heap_dist + (size_t)THREAD_ID() * neighbors;
+        int* best_idx = heap_idx + (size_t)THREAD_ID() * neighbors;
+#pragma omp for schedule(dynamic, SIM_BLOCK)
+        for (i = 0; i < n; i++) {
+            const double* row_i = MAT_ROW(data, i);
+            int size = 0;
+            for (j = 0; j < n; j++) {
+                const double* row_j = MAT_ROW(data, j);
+                double dot = 0, dist;
+                if (j == i) continue;
+                for (t = 0; t < d; t++)
+                    dot += row_i[t] * row_j[t];
+                dist = norms[i] + norms[j] - 2 * dot;
+                dist = dist > 0 ? dist : 0; /* Same rounding guard as the dense matrix*/
+                if (cutoff >= 0 && dist > cutoff) continue;
+                if (neighbors)
+                    size = push_neighbor(best_dist, best_idx, size, neighbors, dist, j);
+                else {
+                    edges[(size_t)i * width + size] = j;
+                    values[(size_t)i * width + size++] = exp(-dist / 2);
+                }
+            }
+            for (t = 0; neighbors && t < size; t++) {
+                edges[(size_t)i * width + t] = best_idx[t];
+                values[(size_t)i * width + t] = exp(-best_dist[t] / 2);
+            }
+            counts[i] = size;
+        }
+    }
+
+    sparse = symmetrize_neighbors(edges, values, counts, n, width, degrees);
+    free(norms); free(counts); free(heap_dist); free(heap_idx); free(edges); free(values);
+    STATS_FLOPS(2.0 * n * n * d);
+    STATS_END(STAT_SIMILARITY);
+    return sparse;
+}
+
+/* Scale a sparse similarity matrix in place into D^-1/2 * A * D^-1/2. Params: sparse - the matrix,
+degrees - its row sums. Ret: 0 on success, 1 on failure.*/
+int normalize_sparse_similarity(SparseMatrix* sparse, const double* degrees) {
+    int i, n = sparse->rows;
+    size_t p;
+    double* inv_sqrt = (double*)malloc((n ? n : 1) * sizeof(double)); /* d^-1/2, 0 for isolated vectors*/
+    if (!inv_sqrt) return 1;
+
+    STATS_BEGIN(STAT_NORMALIZE);
+    for (i = 0; i < n; i++)
+        inv_sqrt[i] = degrees[i] > 0 ? 1.0 / sqrt(degrees[i]) : 0.0;
+
+#pragma omp parallel for private(p) schedule(dynamic, SIM_BLOCK)
+    for (i = 0; i < n; i++)
+        for (p = sparse->row_start[i]; p < sparse->row_start[i + 1]; p++)
+            sparse->values[p] *= inv_sqrt[i] * inv_sqrt[sparse->col_index[p]];
+    free(inv_sqrt);
+    STATS_FLOPS(2.0 * sparse->row_start[n]);
+    STATS_END(STAT_NORMALIZE);
+    return 0;
+}
+
+/* Mean silhouette coefficient of one or more labelings of data, Euclidean distances. Row blocks of SIM_BLOCK
+vectors run in parallel; each streams SIM_BLOCK x SIM_BLOCK distance tiles (the squared distances of
+compute_similarity) and adds every tile into the per cluster distance sums of all labelings at once, so one
+pass over the pairs scores them all and nothing n x n is stored. A vector alone in its cluster scores 0.
+Params: data - n x d input, labels - labelings x n cluster indices, row-major, labeling l in 0..clusters[l]-1,
+labelings - how many, clusters - cluster count of each labeling, scores - receives a score per labeling (NaN when
+fewer than 2 clusters are used). Ret: 0 on success, 1 on failure.*/
+int compute_silhouette(const Matrix* data, const int* labels, int labelings, const int* clusters, double* scores) {
+    int i, j, t, l, c, ib, jb, n = data->rows, d = data->cols, threads = THREAD_COUNT(), total = 0;
+    int* offsets = (int*)malloc((labelings + 1) * sizeof(int)); /* Start of each labeling's clusters*/
+    double *norms = NULL, *sizes = NULL, *sums = NULL, *tiles = NULL, *coefficients = NULL;
+
+    if (!offsets) return 1;
+    for (l = 0; l < labelings; l++) {
+        offsets[l] = total;
+        total += clusters[l];
+    }
+    offsets[labelings] = total;
+    norms = (double*)malloc((n ? n : 1) * sizeof(double));
+    sizes = (double*)calloc(total ? total : 1, sizeof(double));
+    sums = (double*)malloc(((size_t)threads * SIM_BLOCK * total + 1) * sizeof(double));
+    tiles = (double*)malloc((size_t)threads * SIM_BLOCK * SIM_BLOCK * sizeof(double));
+    coefficients = (double*)malloc(((size_t)labelings * n + 1) * sizeof(double));
+    if (!norms || !sizes || !sums || !tiles || !coefficients) {
+        free(offsets); free(norms); free(sizes); free(sums); free(tiles); free(coefficients);
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        norms[i] = 0;
+        for (t = 0; t < d; t++)
+            norms[i] += MAT(data, i, t) * MAT(data, i, t);
+    }
+    for (l = 0; l < labelings; l++)
+        for (j = 0; j < n; j++)
+            sizes[offsets[l] + labels[(size_t)l * n + j]]++;
+
+#pragma omp parallel for private(i, j, t, l, c, jb) schedule(dynamic)
+    for (ib = 0; ib < n; ib += SIM_BLOCK) {
+        int i_end = ib + SIM_BLOCK < n ? ib + SIM_BLOCK : n;
+        double* sum = sums + (size_t)THREAD_ID() * SIM_BLOCK * total; /* (i - ib) x total distance sums*/
+        double* tile = tiles + (size_t)THREAD_ID() * SIM_BLOCK * SIM_BLOCK;
+
+        memset(sum, 0, (size_t)(i_end - ib) * total * sizeof(double));
+        for (jb = 0; jb < n; jb += SIM_BLOCK) {
+            int j_end = jb + SIM_BLOCK < n ? jb + SIM_BLOCK : n;
+            for (i = ib; i < i_end; i++) {
+                const double* row_i = MAT_ROW(data, i);
+                for (j = jb; j < j_end; j++) {
+                    const double* row_j = MAT_ROW(data, j);
+                    double dot = 0, dist;
+                    for (t = 0; t < d; t++)
+                        dot += row_i[t] * row_j[t];
+                    dist = norms[i] + norms[j] - 2 * dot;
+                    tile[(i - ib) * SIM_BLOCK + (j - jb)] = j != i && dist > 0 ? sqrt(dist) : 0;
+                }
+            }
+            for (l = 0; l < labelings; l++) {
+                const int* label = labels + (size_t)l * n;
+                for (i = ib; i < i_end; i++) {
+                    double* cluster_sum = sum + (size_t)(i - ib) * total + offsets[l];
+                    const double* distances = tile + (i - ib) * SIM_BLOCK;
+                    for (j = jb; j < j_end; j++)
+                        cluster_sum[label[j]] += distances[j - jb];
+                }
+            }
+        }
+        for (l = 0; l < labelings; l++) {
+            for (i = ib; i < i_end; i++) {
+                const double* cluster_sum = sum + (size_t)(i - ib) * total + offsets[l];
+                const double* size = sizes + offsets[l];
+                int own = labels[(size_t)l * n + i];
+                double a, b = HUGE_VAL, s = 0;
+                for (c = 0; c < clusters[l]; c++) /* Nearest other cluster by mean distance*/
+                    if (c != own && size[c] > 0 && cluster_sum[c] / size[c] < b)
+                        b = cluster_sum[c] / size[c];
+                if (size[own] > 1 && b < HUGE_VAL) {
+                    a = cluster_sum[own] / (size[own] - 1);
+                    s = (a > b ? a : b) > 0 ? (b - a) / (a > b ? a : b) : 0;
+                }
+                coefficients[(size_t)l * n + i] = b < HUGE_VAL ? s : NAN;
+            }
+        }
+    }
+
+    for (l = 0; l < labelings; l++) { /* In order, so the score does not depend on the schedule*/
+        double total_score = 0;
+        for (i = 0; i < n; i++)
+            total_score += coefficients[(size_t)l * n + i];
+        scores[l] = n ? total_score / n : NAN;
+    }
+    free(offsets); free(norms); free(sizes); free(sums); free(tiles); free(coefficients);
+    return 0;
+}
+
+/* Lloyd's k-means with the semantics of kmeans.py: the first k vectors are the starting centroids, every vector
+goes to the first nearest centroid, centroids are the in order means of their clusters (an empty cluster, where
+kmeans.py would fail, keeps its centroid), and it stops once no centroid moved by epsilon or more, or after
+max_iter rounds. Assignment runs in parallel; sums stay sequential so the centroids are bit for bit kmeans.py's.
+Params: data - n x d input, k - number of clusters (1..n), max_iter&epsilon - stopping rule, labels - receives
+the cluster of every vector from the last assignment. Ret: 0 on success, 1 on failure.*/
+int perform_kmeans(const Matrix* data, int k, int max_iter, double epsilon, int* labels) {
+    int i, j, c, iter, converged = 0, n = data->rows, d = data->cols;
+    Matrix* centroids = create_matrix(k, d);
+    Matrix* updated = create_matrix(k, d);
+    int* sizes = (int*)malloc((k ? k : 1) * sizeof(int));
+    if (!centroids || !updated || !sizes || k < 1 || k > n) {
+        destroy_matrix(centroids);
+        destroy_matrix(updated);
+        free(sizes);
+        return 1;
+    }
+
+    for (c = 0; c < k; c++)
+        memcpy(MAT_ROW(centroids, c), MAT_ROW(data, c), d * sizeof(double));
+    for (iter = 0; iter < max_iter && !converged; iter++) {
+#pragma omp parallel for private(c) schedule(static)
+        for (i = 0; i < n; i++) { /* Nearest centroid, compared as kmeans.py does by the distance itself*/
+            const double* row = MAT_ROW(data, i);
+            double best = sqrt(squared_euclidean_distance(MAT_ROW(centroids, 0), row, d)), dist;
+            labels[i] = 0;
+            for (c = 1; c < k; c++) {
+                dist = sqrt(squared_euclidean_distance(MAT_ROW(centroids, c), row, d));
+                if (dist < best) {
+                    best = dist;
+                    labels[i] = c;
+                }
+            }
+        }
+        memset(sizes, 0, k * sizeof(int));
+        for (c = 0; c < k; c++)
+            memset(MAT_ROW(updated, c), 0, d * sizeof(double));
+        for (i = 0; i < n; i++) { /* Cluster sums in input order*/
+            double* sum = MAT_ROW(updated, labels[i]);
+            const double* row = MAT_ROW(data, i);
+            sizes[labels[i]]++;
+            for (j = 0; j < d; j++)
+                sum[j] += row[j];
+        }
+        converged = 1;
+        for (c = 0; c < k; c++) {
+            double* centroid = MAT_ROW(updated, c);
+            if (!sizes[c]) memcpy(centroid, MAT_ROW(centroids, c), d * sizeof(double));
+            else for (j = 0; j < d; j++)
+                centroid[j] /= sizes[c];
+            if (!(sqrt(squared_euclidean_distance(MAT_ROW(centroids, c), centroid, d)) < epsilon))
+                converged = 0;
+            memcpy(MAT_ROW(centroids, c), centroid, d * sizeof(double));
+        }
+    }
+    destroy_matrix(centroids);
+    destroy_matrix(updated);
+    free(sizes);
+    return 0;
+}
+
+/* Computes the product of matrix A (n x k) and its transposed A^t. Params: A - the matrix,
+AxAt - n x n matrix to hold the result. Ret: NONE.*/
+void multiply_matrix_by_its_transposed(const Matrix* A, Matrix* AxAt) {
+    int i, j, l, n = A->rows, k = A->cols;
     double sum;
 
     for (i = 0; i < n; i++) { /* Compute Matrix H*H^t for calculating the denominator*/
+        const double* a_i = MAT_ROW(A, i);
         for (j = 0; j < n; j++) {
+            const double* a_j = MAT_ROW(A, j);
             sum = 0;
             for (l = 0; l < k; l++) 
-                sum += A[i][l] * A[j][l]; /* not l then j because we want to multiply by the transposed matrix*/
-            AxAt[i][j] = sum;
+                sum += a_i[l] * a_j[l]; /* not l then j because we want to multiply by the transposed matrix*/
+            MAT(AxAt, i, j) = sum;
         }
     }
 }
 
-/* Perform the SymNMF algorithm. Params: W - normalized similarity matrix, H - staring matrix,
-n - rows (number of vectors), k - cols (dimension). Ret: the final SymNMF H matrix, NULL on failure.*/
-double** perform_symnmf(double** W, double** H, int n, int k) {
-    const double epsilon = 1e-4, betta = 0.5; /* betta from the given formula */
-    const int max_iter = 300;
-    double diff, numerator, denominator; /* helper temp variables*/
-    int i, j, l, iter; /* iterators */
-    double **temp, **HxHt = allocate_matrix(n, n), **H_new = allocate_matrix(n, k);
-    if (!H_new || !HxHt || n==0) {
-        if (HxHt) free_matrix(HxHt, n);
-        if (H_new) free_matrix(H_new, n);
-        return n==0 ? H : NULL;
+
+/* Growable text buffer that one thread formats a block of rows into.*/
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} OutputBuffer;
+
+/* Formats one row of some matrix into out. Params: out - buffer, source - the matrix, row - index.*/
+typedef void (*RowFormatter)(OutputBuffer* out, const void* source, int row);
+
+/* Make room for extra more bytes. Params: out - buffer, extra - byte count. Ret: 0 on success, 1 on failure.*/
+static int reserve_output(OutputBuffer* out, size_t extra) {
+    if (out->failed) return 1;
+    if (out->length + extra > out->capacity) {
+        size_t capacity = 2 * out->capacity + extra;
+        char* grown = (char*)realloc(out->data, capacity);
+        if (!grown) {
+            out->failed = 1;
+            return 1;
+        }
+        out->data = grown;
+        out->capacity = capacity;
     }
-    for (iter = 0; iter < max_iter; iter++) {
-        diff = 0;
-        multiply_matrix_by_its_transposed(H, HxHt, n, k); /* H*H^t */
-        for (i = 0; i < n; i++) {
-            for (j = 0; j < k; j++) {
-                numerator = 0;
-                denominator = 0;
-                for (l = 0; l < n; l++) {
-                    numerator += W[i][l] * H[l][j]; /* W*H */
-                    denominator += HxHt[i][l] * H[l][j]; /* (H*H^t)*H */
-                }
-                denominator = denominator == 0 ? 1e-6 : denominator;
-                H_new[i][j] = H[i][j] * (1 - betta + betta*numerator/denominator); /* formula */
-                diff += (H_new[i][j] - H[i][j]) * (H_new[i][j] - H[i][j]); /* squared Frobenius partial sum*/
-            }
+    return 0;
+}
+
+/* Append value the way printf("%.4f") writes it, followed by separator. Finite values below
+PRINT_FAST_LIMIT are scaled by 10^4 and rounded to an integer; that is exact unless the scaled
+value lies within its own rounding error of a tie, and those (with huge, infinite and NaN values)
+go through snprintf. Params: out - buffer, value - number, separator - char after it. Ret: None.*/
+static void put_fixed4(OutputBuffer* out, double value, char separator) {
+    double scaled = fabs(value) * 10000, whole = floor(scaled), fraction = scaled - whole;
+    unsigned long integer, decimals;
+    char digits[16];
+    char* p;
+    int n = 0;
+
+    if (reserve_output(out, PRINT_FIELD_BYTES)) return;
+    if (!(fabs(value) < PRINT_FAST_LIMIT) || fabs(fraction - 0.5) <= 1e-9 + scaled * 1e-15) {
+        n = snprintf(out->data + out->length, PRINT_FIELD_BYTES - 1, "%.4f", value);
+        if (n < 0 || n >= PRINT_FIELD_BYTES - 1) {
+            out->failed = 1;
+            return;
         }
-        temp = H; /* Swap H and H_new (We dont want to lose the allocated space)*/
-        H = H_new;
-        H_new = temp;
-        if (diff < epsilon) break; /* Check convergence*/
+        out->length += n;
+        out->data[out->length++] = separator;
+        return;
     }
-    free_matrix(H_new, n);
-    free_matrix(HxHt, n);
-    return H;
+    if (fraction > 0.5) whole += 1;
+    integer = (unsigned long)floor(whole / 10000);
+    decimals = (unsigned long)(whole - (double)integer * 10000);
+    p = out->data + out->length;
+    if (value < 0 || (value == 0 && 1 / value < 0)) *p++ = '-'; /* printf keeps the sign of -0.0000*/
+    do {
+        digits[n++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer);
+    while (n) *p++ = digits[--n];
+    p[0] = '.';
+    p[1] = (char)('0' + decimals / 1000);
+    p[2] = (char)('0' + decimals / 100 % 10);
+    p[3] = (char)('0' + decimals / 10 % 10);
+    p[4] = (char)('0' + decimals % 10);
+    p[5] = separator;
+    out->length = (size_t)(p + 6 - out->data);
 }
 
-/*Function to print the matrix. Params: matrix - the matrix, rows&cols - size. Ret: None.*/
-void print_matrix(double** matrix, int rows, int cols) {
-    int i, j;
+/* Append a non negative integer followed by separator. Params: out - buffer, value - number,
+separator - char after it. Ret: None.*/
+static void put_index(OutputBuffer* out, size_t value, char separator) {
+    char digits[24];
+    int n = 0;
+    if (reserve_output(out, sizeof(digits) + 1)) return;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) out->data[out->length++] = digits[--n];
+    out->data[out->length++] = separator;
+}
 
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols-1; j++) { /* N-1 because we dont want to have a comma after the last element*/
-            printf("%.4f,", matrix[i][j]);
+/* Write rows 0..rows-1 to stdout. Blocks of rows are formatted in parallel into per block
+buffers, which are then written in order, a batch of blocks at a time. Params: rows - row count,
+row_bytes - estimated bytes per row, format - row formatter, source - the matrix. Ret: None.*/
+static void print_rows(int rows, size_t row_bytes, RowFormatter format, const void* source) {
+    int batch = 2 * THREAD_COUNT(), block_rows = (int)(PRINT_BLOCK_BYTES / (row_bytes + 1)) + 1;
+    int first, b, failed = 0;
+    OutputBuffer* buffers = (OutputBuffer*)calloc(batch, sizeof(OutputBuffer));
+    if (!buffers) {
+        printError(0);
+        return;
+    }
+    STATS_BEGIN(STAT_OUTPUT);
+    for (first = 0; first < rows && !failed; first += batch * block_rows) {
+#pragma omp parallel for schedule(dynamic, 1)
+        for (b = 0; b < batch; b++) {
+            int i, begin = first + b * block_rows, end = begin + block_rows;
+            buffers[b].length = 0;
+            for (i = begin; i < end && i < rows; i++)
+                format(&buffers[b], source, i);
         }
-        printf("%.4f", matrix[i][cols-1]); /* Print the last element without a comma*/
-        printf("\n");
+        for (b = 0; b < batch && !failed; b++) {
+            if (buffers[b].failed) failed = 1;
+            else fwrite(buffers[b].data, 1, buffers[b].length, stdout);
+        }
+    }
+    for (b = 0; b < batch; b++)
+        free(buffers[b].data);
+    free(buffers);
+    STATS_END(STAT_OUTPUT);
+    if (failed) printError(0);
+}
+
+static void format_dense_row(OutputBuffer* out, const void* source, int i) {
+    const Matrix* matrix = (const Matrix*)source;
+    const double* row = MAT_ROW(matrix, i);
+    int j;
+    for (j = 0; j < matrix->cols; j++)
+        put_fixed4(out, row[j], j == matrix->cols - 1 ? '\n' : ',');
+}
+
+static void format_packed_row(OutputBuffer* out, const void* source, int i) {
+    const PackedMatrix* packed = (const PackedMatrix*)source;
+    int j, n = packed->n;
+    for (j = 0; j < i; j++) /* Below the diagonal comes from the mirrored entry*/
+        put_fixed4(out, PACKED(packed, j, i), ',');
+    for (j = i; j < n; j++)
+        put_fixed4(out, PACKED(packed, i, j), j == n - 1 ? '\n' : ',');
+}
+
+static void format_sparse_row(OutputBuffer* out, const void* source, int i) {
+    const SparseMatrix* sparse = (const SparseMatrix*)source;
+    size_t p;
+    for (p = sparse->row_start[i]; p < sparse->row_start[i + 1]; p++) {
+        put_index(out, (size_t)i, ',');
+        put_index(out, (size_t)sparse->col_index[p], ',');
+        put_fixed4(out, sparse->values[p], '\n');
     }
 }
 
-/*Function to print the diagonal matrix. Params: ei_values - the diagonal values,
-N - matrix size. Ret: None.*/
+/*Function to print the matrix. Params: matrix - the matrix. Ret: None.*/
+void print_matrix(const Matrix* matrix) {
+    print_rows(matrix->rows, (size_t)matrix->cols * 7, format_dense_row, matrix);
+}
+
+/*Function to print a packed symmetric matrix as a full one. Params: packed - the matrix. Ret: None.*/
+void print_packed_matrix(const PackedMatrix* packed) {
+    print_rows(packed->n, (size_t)packed->n * 7, format_packed_row, packed);
+}
+
+/*Function to print the non zero entries of a sparse matrix, one "row,col,value" line each.
+Params: sparse - the matrix. Ret: None.*/
+void print_sparse_matrix(const SparseMatrix* sparse) {
+    size_t entries = sparse->rows ? sparse->row_start[sparse->rows] / sparse->rows : 0;
+    print_rows(sparse->rows, entries * 20, format_sparse_row, sparse);
+}
+
+/*Function to print the diagonal matrix. Every row is the same "0.0000,...,0.0000\n" template
+with one field replaced, so only the N diagonal values are formatted.
+Params: ei_values - the diagonal values, N - matrix size. Ret: None.*/
 void print_diagonal_matrix(double* ei_values, int N) {
-    int i, j;
-    
-    for (i = 0; i < N; i++) {
-        for (j = 0; j < N-1; j++) { /* N-1 because we dont want to have a comma after the last element*/
-            if (i == j)
-                printf("%.4f,", ei_values[i]);
-            else
-                printf("0.0000,");
-        }
-        if (i == N-1) /* Print the last element without a comma*/
-            printf("%.4f", ei_values[i]);
-        else  
-            printf("0.0000");
-        
-        printf("\n");
+    size_t row_bytes = (size_t)N * 7, at;
+    char* zeros = (char*)malloc(row_bytes);
+    OutputBuffer value = {NULL, 0, 0, 0};
+    int i;
+
+    if (!zeros) {
+        printError(0);
+        return;
+    }
+    STATS_BEGIN(STAT_OUTPUT);
+    for (at = 0; at < row_bytes; at += 7) {
+        memcpy(zeros + at, "0.0000,", 7);
     }
+    zeros[row_bytes - 1] = '\n';
+    for (i = 0; i < N && !value.failed; i++) {
+        at = (size_t)i * 7;
+        value.length = 0;
+        put_fixed4(&value, ei_values[i], zeros[at + 6]);
+        if (value.failed) break;
+        fwrite(zeros, 1, at, stdout);
+        fwrite(value.data, 1, value.length, stdout);
+        fwrite(zeros + at + 7, 1, row_bytes - at - 7, stdout);
+    }
+    STATS_END(STAT_OUTPUT);
+    if (value.failed) printError(0);
+    free(value.data);
+    free(zeros);
 }
 
-/* Function to find the dimensions of the vectors and their count (rows and cols of matrix).
-Params: filename - path to file, rows&cols will have sizes at end of func. Ret: None. EXITS: on failure.*/
-int get_matrix_dimensions(const char *filename, int *rows, int *cols) { 
-    FILE *file = fopen(filename, "r"); /* Open the file for reading*/
-    char *line = NULL;
-    size_t len = 0;
-    int first_row_cols = -1; /* Stores the column count of the first row to check consistency*/
-    *rows = *cols = 0;
+/* One slice of the input file, parsed independently into its own value buffer.*/
+typedef struct {
+    const char* begin;
+    const char* end;
+    double* values;
+    size_t count;
+    size_t capacity;
+    int rows;
+    int cols;
+    int failed;
+} ParseChunk;
 
-    if (!file)
-        return 1;
+static const double powers_of_ten[] = { /* Every power exactly representable in a double*/
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
 
-    while (getline(&line, &len, file) != -1) { /* Read file line by line*/
-        int current_cols = 0; /* Count columns in the current row*/
-        char *tmp = strdup(line); /* Create a copy of the line for tokenization*/
-        char *token = strtok(tmp, ",\n"); /* Split line by comma or newline*/
-        
-        while (token) { /* Count the number of columns in the row*/
-            current_cols++;
-            token = strtok(NULL, ",\n");
+/* Parse one comma separated field in [p, end). Short decimals take the exact fast path
+(at most 15 significant digits scaled by 10^-22..10^22: both operands are exact, so the
+single rounding of * or / gives the correctly rounded result); everything else is copied
+out and handed to strtod. Params: p&end - field start and buffer end, value - result.
+Ret: pointer past the field (at ',', '\r', '\n' or end), NULL if it is not a number.*/
+static const char* parse_field(const char* p, const char* end, double* value) {
+    const char* start = p;
+    double mantissa = 0;
+    int digits = 0, any = 0, negative = 0, exponent = 0, power = 0, power_negative = 0;
+    char buffer[64];
+    char *copy, *stop;
+    size_t length;
+
+    while (p < end && (*p == ' ' || *p == '\t')) p++; /* strtod skips leading blanks too*/
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) digits++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = 1) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) digits++;
+            exponent--;
         }
-        free(tmp); 
-        
-        if (first_row_cols == -1) { 
-            first_row_cols = current_cols;
-            *cols = first_row_cols;
-        } else if (current_cols != first_row_cols){ /* Ensure all rows have the same column count*/
-            free(line);
-            fclose(file);
-            return 1;
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '-' || *p == '+')) power_negative = (*p++ == '-');
+        if (p == end || *p < '0' || *p > '9') any = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            if (power < 10000) power = power * 10 + (*p - '0');
+        exponent += power_negative ? -power : power;
+    }
+    if (any && digits <= 15 && exponent >= -22 && exponent <= 22
+        && (p == end || *p == ',' || *p == '\n' || *p == '\r')) {
+        mantissa = exponent < 0 ? mantissa / powers_of_ten[-exponent] : mantissa * powers_of_ten[exponent];
+        *value = negative ? -mantissa : mantissa;
+        return p;
+    }
+
+    /* Slow path: strtod on a NUL terminated copy (the mapped file has no terminator)*/
+    for (p = start; p < end && *p != ',' && *p != '\n' && *p != '\r'; p++);
+    length = (size_t)(p - start);
+    copy = length < sizeof(buffer) ? buffer : (char*)malloc(length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+    *value = strtod(copy, &stop);
+    any = length > 0 && stop == copy + length; /* The whole field must be the number*/
+    if (copy != buffer) free(copy);
+    return any ? p : NULL;
+}
+
+/* Parse the rows of one chunk, checking that they all have the same width.
+Params: chunk - slice to parse, its values/rows/cols/failed are filled in. Ret: None.*/
+static void parse_chunk(ParseChunk* chunk) {
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+
+    chunk->capacity = (size_t)(end - p) / 8 + 16; /* Grown geometrically if the guess is short*/
+    chunk->values = (double*)malloc(chunk->capacity * sizeof(double));
+    if (!chunk->values) {
+        chunk->failed = 1;
+        return;
+    }
+    while (p < end) {
+        int cols = 0;
+        if (*p == '\n' || *p == '\r') { /* Skip blank lines*/
+            p++;
+            continue;
+        }
+        for (;;) {
+            double value;
+            if (chunk->count == chunk->capacity) {
+                double* grown = (double*)realloc(chunk->values, 2 * chunk->capacity * sizeof(double));
+                if (!grown) {
+                    chunk->failed = 1;
+                    return;
+                }
+                chunk->values = grown;
+                chunk->capacity *= 2;
+            }
+            p = parse_field(p, end, &value);
+            if (!p) {
+                chunk->failed = 1;
+                return;
+            }
+            chunk->values[chunk->count++] = value;
+            cols++;
+            if (p == end || *p != ',') break;
+            p++;
         }
-        (*rows)++; /* Increment row count*/
+        if (p < end && *p == '\r') p++;
+        if (p < end && *p == '\n') p++;
+        if (chunk->rows == 0) chunk->cols = cols;
+        else if (cols != chunk->cols) { /* Ensure all rows have the same column count*/
+            chunk->failed = 1;
+            return;
+        }
+        chunk->rows++;
     }
+}
 
-    free(line);
-    fclose(file); 
-    if (*rows == 0 || *cols == 0) return 1; /*(1 is error)*/
-    return 0;
+/* Read all of a stream that cannot be mapped (a pipe, say) into memory.
+Params: fd - open descriptor, size - set to the byte count. Ret: buffer, NULL on failure.*/
+static char* slurp_file(int fd, size_t* size) {
+    size_t capacity = 1 << 16;
+    char* buffer = (char*)malloc(capacity);
+    ssize_t got;
+    *size = 0;
+    while (buffer && (got = read(fd, buffer + *size, capacity - *size)) > 0) {
+        *size += (size_t)got;
+        if (*size == capacity) {
+            char* grown = (char*)realloc(buffer, capacity *= 2);
+            if (!grown) free(buffer);
+            buffer = grown;
+        }
+    }
+    if (buffer && got < 0) {
+        free(buffer);
+        buffer = NULL;
+    }
+    return buffer;
 }
 
-/* Function to read the txt file into a dynamically allocated 2D array.
-Params: filename - path to file, rows&cols - size. Ret: None, NULL on failure.*/
-double **read_matrix(const char *filename, int rows, int cols) {
-    char *line = NULL;
-    size_t len = 0;
-    int row = 0;
-    double **matrix;
-    FILE *file = fopen(filename, "r"); 
-    if (!file) return NULL;
-    matrix = allocate_matrix(rows, cols);
+/* Nonzero when the host stores numbers little-endian, the byte order of binary files.*/
+static int host_little_endian(void) {
+    const unsigned short one = 1;
+    return *(const unsigned char*)&one;
+}
+
+/* Copy one size byte number between host order and little-endian (its own inverse).
+Params: dst&src - buffers, size - 4 or 8. Ret: None.*/
+static void convert_little_endian(void* dst, const void* src, int size) {
+    const unsigned char* from = (const unsigned char*)src;
+    unsigned char* to = (unsigned char*)dst;
+    int b;
+    if (host_little_endian()) memcpy(to, from, size);
+    else for (b = 0; b < size; b++) to[b] = from[size - 1 - b];
+}
+
+/* Encode/decode an unsigned little-endian integer field of the binary header.*/
+static void put_header_field(unsigned char* p, size_t value, int size) {
+    int b;
+    for (b = 0; b < size; b++, value >>= 8) p[b] = (unsigned char)(value & 0xff);
+}
+
+static size_t get_header_field(const unsigned char* p, int size) {
+    size_t value = 0;
+    int b;
+    for (b = size - 1; b >= 0; b--) {
+        if (b >= (int)sizeof(size_t) && p[b]) return (size_t)-1; /* Does not fit*/
+        if (b < (int)sizeof(size_t)) value = (value << 8) | p[b];
+    }
+    return value;
+}
+
+/* Decode a binary matrix file held in memory (layout in symnmf.h).
+Params: text&size - file contents. Ret: the matrix, NULL if malformed or on failure.*/
+static Matrix* parse_binary_matrix(const char* text, size_t size) {
+    const unsigned char* header = (const unsigned char*)text;
+    size_t rows = get_header_field(header + 8, 8), cols = get_header_field(header + 16, 8);
+    int itemsize = (int)get_header_field(header + 24, 4);
+    const char* payload = text + BINARY_HEADER_BYTES;
+    Matrix* matrix;
+    long i, count;
+
+    if ((itemsize != BINARY_FLOAT64 && itemsize != BINARY_FLOAT32) || rows == 0 || cols == 0
+        || rows > INT_MAX || cols > INT_MAX || (size - BINARY_HEADER_BYTES) / itemsize / cols < rows
+        || size - BINARY_HEADER_BYTES != rows * cols * itemsize)
+        return NULL;
+    matrix = create_matrix((int)rows, (int)cols);
     if (!matrix) return NULL;
-    
-    while (getline(&line, &len, file) != -1 && row < rows) {
-        char *token = strtok(line, ",\n");
-        int col = 0;
-        while (token && col < cols) {
-            char *endptr;
-            double value = strtod(token, &endptr);
-
-            /* Check if token is a valid number */
-            if (*endptr != '\0' && *endptr != '\n') {
-                free(line);
-                free_matrix(matrix, rows);
-                fclose(file);
-                return NULL;
+    count = (long)(rows * cols);
+    if (itemsize == BINARY_FLOAT64 && host_little_endian())
+        memcpy(matrix->data, payload, rows * cols * sizeof(double));
+    else {
+#pragma omp parallel for schedule(static)
+        for (i = 0; i < count; i++) {
+            double value;
+            float single;
+            if (itemsize == BINARY_FLOAT64) convert_little_endian(&value, payload + (size_t)i * 8, 8);
+            else {
+                convert_little_endian(&single, payload + (size_t)i * 4, 4);
+                value = single;
             }
-            matrix[row][col] = value;
-            token = strtok(NULL, ",\n");
-            col++;
+            matrix->data[i] = value;
         }
-        if (col != cols) {
-            free(line);
-            free_matrix(matrix, rows);
-            fclose(file);
-            return NULL;
+    }
+    return matrix;
+}
+
+/* A binary matrix file being written through a shared mapping.*/
+typedef struct {
+    unsigned char* map;
+    size_t bytes;
+    int itemsize;
+} BinaryOutput;
+
+/* Create (or truncate) filename, size it for a rows x cols payload, map it and write the
+header. The payload starts out all zero. Params: out - filled in, filename - path, rows&cols -
+size, itemsize - BINARY_FLOAT64 or BINARY_FLOAT32. Ret: 0 on success, 1 on failure.*/
+static int open_binary_output(BinaryOutput* out, const char* filename, int rows, int cols, int itemsize) {
+    int fd;
+    out->itemsize = itemsize;
+    out->bytes = BINARY_HEADER_BYTES + (size_t)rows * cols * itemsize;
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 1;
+    if (ftruncate(fd, (off_t)out->bytes)) {
+        close(fd);
+        return 1;
+    }
+    out->map = (unsigned char*)mmap(NULL, out->bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (out->map == MAP_FAILED) return 1;
+    memcpy(out->map, BINARY_MAGIC, 8);
+    put_header_field(out->map + 8, (size_t)rows, 8);
+    put_header_field(out->map + 16, (size_t)cols, 8);
+    put_header_field(out->map + 24, (size_t)itemsize, 4);
+    STATS_BEGIN(STAT_OUTPUT); /* Ends in close_binary_output*/
+    return 0;
+}
+
+/* Store element number index (row-major) of the payload. Params: out - file, index - position,
+value - the element. Ret: None.*/
+static void put_binary_element(const BinaryOutput* out, size_t index, double value) {
+    unsigned char* p = out->map + BINARY_HEADER_BYTES + index * out->itemsize;
+    if (out->itemsize == BINARY_FLOAT64) convert_little_endian(p, &value, 8);
+    else {
+        float single = (float)value;
+        convert_little_endian(p, &single, 4);
+    }
+}
+
+/* Unmap the file. Params: out - file. Ret: 0 on success, 1 on failure.*/
+static int close_binary_output(BinaryOutput* out) {
+    int failed = munmap(out->map, out->bytes) != 0;
+    STATS_END(STAT_OUTPUT);
+    return failed;
+}
+
+/* Write a dense matrix as a binary matrix file. Params: filename - path, matrix - data,
+itemsize - BINARY_FLOAT64 or BINARY_FLOAT32. Ret: 0 on success, 1 on failure.*/
+int write_binary_matrix(const char* filename, const Matrix* matrix, int itemsize) {
+    BinaryOutput out;
+    int i, j;
+    if (open_binary_output(&out, filename, matrix->rows, matrix->cols, itemsize)) return 1;
+#pragma omp parallel for private(j) schedule(static)
+    for (i = 0; i < matrix->rows; i++)
+        for (j = 0; j < matrix->cols; j++)
+            put_binary_element(&out, (size_t)i * matrix->cols + j, MAT(matrix, i, j));
+    return close_binary_output(&out);
+}
+
+/* Write a packed symmetric matrix in full n x n form. Params: filename - path, packed - data,
+itemsize - element size. Ret: 0 on success, 1 on failure.*/
+int write_binary_packed(const char* filename, const PackedMatrix* packed, int itemsize) {
+    BinaryOutput out;
+    int i, j, n = packed->n;
+    if (open_binary_output(&out, filename, n, n, itemsize)) return 1;
+#pragma omp parallel for private(j) schedule(static)
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            put_binary_element(&out, (size_t)i * n + j, i <= j ? PACKED(packed, i, j) : PACKED(packed, j, i));
+    return close_binary_output(&out);
+}
+
+/* Write a sparse matrix in dense form; only the stored entries are touched, the rest of the
+(sparse on disk) file stays zero. Params: filename - path, sparse - data, itemsize - element
+size. Ret: 0 on success, 1 on failure.*/
+int write_binary_sparse(const char* filename, const SparseMatrix* sparse, int itemsize) {
+    BinaryOutput out;
+    int i;
+    size_t e;
+    if (open_binary_output(&out, filename, sparse->rows, sparse->cols, itemsize)) return 1;
+#pragma omp parallel for private(e) schedule(static)
+    for (i = 0; i < sparse->rows; i++)
+        for (e = sparse->row_start[i]; e < sparse->row_start[i + 1]; e++)
+            put_binary_element(&out, (size_t)i * sparse->cols + sparse->col_index[e], sparse->values[e]);
+    return close_binary_output(&out);
+}
+
+/* Write the n x n diagonal matrix diag(values). Params: filename - path, values - diagonal,
+n - size, itemsize - element size. Ret: 0 on success, 1 on failure.*/
+int write_binary_diagonal(const char* filename, const double* values, int n, int itemsize) {
+    BinaryOutput out;
+    int i;
+    if (open_binary_output(&out, filename, n, n, itemsize)) return 1;
+    for (i = 0; i < n; i++)
+        put_binary_element(&out, (size_t)i * n + i, values[i]);
+    return close_binary_output(&out);
+}
+
+/* Parse comma separated text held in memory: it is cut into chunks at line boundaries, the
+chunks are parsed in parallel, then copied back to back into the matrix. Blank lines are
+skipped; every other row must have the same number of columns.
+Params: text&size - file contents. Ret: the matrix, NULL if malformed or on failure.*/
+static Matrix* parse_text_matrix(const char* text, size_t size) {
+    int count, c, rows = 0, cols = 0, failed = 0;
+    size_t offset = 0;
+    const char* start = text;
+    ParseChunk* chunks;
+    Matrix* matrix = NULL;
+
+    count = (int)(size / PARSE_CHUNK_BYTES) + 1;
+    if (count > 4 * THREAD_COUNT()) count = 4 * THREAD_COUNT();
+    chunks = (ParseChunk*)calloc(count, sizeof(ParseChunk));
+    if (!chunks) return NULL;
+    for (c = 0; c < count; c++) { /* Move each cut forward to just after a newline*/
+        const char* stop = c == count - 1 ? text + size : text + size / count * (c + 1);
+        if (stop < start) stop = start;
+        while (stop < text + size && stop > text && stop[-1] != '\n') stop++;
+        chunks[c].begin = start;
+        chunks[c].end = stop;
+        start = stop;
+    }
+#pragma omp parallel for schedule(dynamic, 1)
+    for (c = 0; c < count; c++)
+        parse_chunk(&chunks[c]);
+
+    for (c = 0; c < count && !failed; c++) {
+        if (chunks[c].failed) failed = 1;
+        else if (chunks[c].rows == 0) continue;
+        else if (rows == 0) cols = chunks[c].cols;
+        else if (chunks[c].cols != cols) failed = 1;
+        rows += chunks[c].rows;
+    }
+    if (!failed && rows > 0 && cols > 0) matrix = create_matrix(rows, cols);
+    for (c = 0; c < count; c++) {
+        if (matrix && chunks[c].count) {
+            memcpy(matrix->data + offset, chunks[c].values, chunks[c].count * sizeof(double));
+            offset += chunks[c].count;
         }
-        row++; 
+        free(chunks[c].values);
     }
+    free(chunks);
+    return matrix;
+}
 
-    free(line); 
-    fclose(file);  
-    return matrix; 
+/* Read a matrix file into a contiguous matrix in a single pass over a mapping of it. Files
+starting with BINARY_MAGIC are decoded directly, anything else is parsed as CSV text.
+Params: filename - path to file. Ret: the matrix, NULL on failure.*/
+Matrix *read_matrix(const char *filename) {
+    int fd, mapped = 0;
+    struct stat info;
+    size_t size = 0;
+    char* text = NULL;
+    Matrix* matrix;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (!fstat(fd, &info) && S_ISREG(info.st_mode) && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        text = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) text = NULL;
+        else mapped = 1;
+    }
+    if (!mapped) text = slurp_file(fd, &size);
+    close(fd);
+    if (!text) return NULL;
+    if (mapped) madvise(text, size, MADV_SEQUENTIAL);
+
+    if (size >= BINARY_HEADER_BYTES && !memcmp(text, BINARY_MAGIC, 8))
+        matrix = parse_binary_matrix(text, size);
+    else
+        matrix = parse_text_matrix(text, size);
+    if (mapped) munmap(text, size);
+    else free(text);
+    return matrix;
 }
 
-/*Main function to implement the required functionality.
-Params: Cmd rgs. Ret: status code.*/
+/* Whether a path names a binary matrix file by its extension. Params: path - file name.
+Ret: BINARY_FLOAT64 for ".bin", BINARY_FLOAT32 for ".f32", 0 otherwise.*/
+static int binary_extension(const char* path) {
+    size_t length = strlen(path);
+    if (length >= 4 && !strcmp(path + length - 4, ".bin")) return BINARY_FLOAT64;
+    if (length >= 4 && !strcmp(path + length - 4, ".f32")) return BINARY_FLOAT32;
+    return 0;
+}
+
+/*Main function to implement the required functionality. Usage: symnmf goal file, or
+symnmf knn file [neighbors [radius]] for the sparse normalized similarity graph. Either form
+takes [-o output] to write the result to a file instead of stdout, and [--binary|--float32]
+to write it as a binary matrix file (also chosen by a .bin/.f32 output extension), and [--stats]
+to report per phase timings on stderr (collected in a make STATS=1 build).
+Input files may be CSV text or binary matrix files. Params: Cmd rgs. Ret: status code.*/
 int main(int argc, char **argv) {
-    char* goal, *fileName;
-    int N = 0, d = 0;
-    double** matrix,**similarity,**normalized;
+    char* goal, *fileName, *output = NULL, *positional[5];
+    int i, count = 0, N = 0, neighbors = DEFAULT_NEIGHBORS, binary = 0, failed = 0, report = 0;
+    double radius = 0;
+    Matrix *matrix;
+    PackedMatrix *similarity;
+    SparseMatrix *sparse;
     double* degreeArray;
-    if (argc != 3) printError(1); /* 1 for quitting */
-    goal = argv[1];
-    fileName = argv[2];
-
-    if (get_matrix_dimensions(fileName, &N, &d)) printError(1); /* 1 for quitting*/
+    SymnmfStats run;
+    for (i = 1; i < argc; i++) { /* Split the options from the positional arguments*/
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) output = argv[++i];
+        else if (!strcmp(argv[i], "--binary")) binary = BINARY_FLOAT64;
+        else if (!strcmp(argv[i], "--float32")) binary = BINARY_FLOAT32;
+        else if (!strcmp(argv[i], "--stats")) report = 1;
+        else if (count < 5) positional[count++] = argv[i];
+        else printError(1); /* 1 for quitting */
+    }
+    if (count < 2) printError(1); /* 1 for quitting */
+    goal = positional[0];
+    fileName = positional[1];
+    if (!strcmp(goal, "knn") && count <= 4) { /* Optional sparse graph parameters*/
+        char *end = "";
+        if (count > 2) neighbors = (int)strtol(positional[2], &end, 10);
+        if (count > 3 && !*end) radius = strtod(positional[3], &end);
+        if (*end || neighbors < 0 || radius < 0 || (neighbors == 0 && radius == 0)) printError(1);
+    } else if (count != 2) printError(1); /* 1 for quitting */
+    if (output && !binary) binary = binary_extension(output);
+    if (binary && !output) printError(1); /* Binary output needs a file to map*/
+    if (output && !binary && !freopen(output, "w", stdout)) printError(1);
 
-    matrix = read_matrix(fileName,N,d); 
+    stats_init(&run);
+    if (report) stats_attach(&run);
+    STATS_BEGIN(STAT_LOAD);
+    matrix = read_matrix(fileName);
+    STATS_END(STAT_LOAD);
     if (matrix == NULL) printError(1); /* 1 for quitting*/
+    N = matrix->rows;
 
-    similarity = compute_similarity_matrix(matrix, N, d);
-    free_matrix(matrix,N);
-    if (similarity == NULL) printError(1); /* 1 for quitting*/
-
-    if (!strcmp(goal, "sym")) 
-        print_matrix(similarity, N, N);
-    else if (!strcmp(goal, "ddg")) {
-        degreeArray = compute_degree_array(similarity, N);
-        if (degreeArray == NULL) printError(0);
-        else {
-            print_diagonal_matrix(degreeArray, N);
-            free(degreeArray);
-        }
-    } else if (!strcmp(goal, "norm")) {
-        normalized = compute_normalized_similarity(similarity, N);
-        if (normalized == NULL) printError(0);
-        else {
-            print_matrix(normalized, N,N);
-            free_matrix(normalized,N);
-        }
-    } else printError(0);
-    free_matrix(similarity,N);
+    degreeArray = (double*)malloc(N * sizeof(double));
+    if (degreeArray == NULL) printError(1); /* 1 for quitting*/
+
+    if (!strcmp(goal, "sym")) {
+        similarity = compute_packed_similarity(matrix, NULL);
+        if (similarity == NULL) failed = 1;
+        else if (binary) failed = write_binary_packed(output, similarity, binary);
+        else print_packed_matrix(similarity);
+        destroy_packed_matrix(similarity);
+    } else if (!strcmp(goal, "ddg")) { /* Only the row sums are needed, nothing N x N is stored*/
+        if (compute_similarity(matrix, NULL, NULL, degreeArray)) failed = 1;
+        else if (binary) failed = write_binary_diagonal(output, degreeArray, N, binary);
+        else print_diagonal_matrix(degreeArray, N);
+    } else if (!strcmp(goal, "norm")) { /* Normalized in place, a single packed matrix at peak*/
+        similarity = compute_packed_similarity(matrix, degreeArray);
+        if (similarity == NULL || normalize_similarity(NULL, similarity, degreeArray)) failed = 1;
+        else if (binary) failed = write_binary_packed(output, similarity, binary);
+        else print_packed_matrix(similarity);
+        destroy_packed_matrix(similarity);
+    } else if (!strcmp(goal, "knn")) { /* Sparse normalized similarity, O(N * neighbors) memory*/
+        sparse = compute_sparse_similarity(matrix, neighbors, radius, degreeArray);
+        if (sparse == NULL || normalize_sparse_similarity(sparse, degreeArray)) failed = 1;
+        else if (binary) failed = write_binary_sparse(output, sparse, binary);
+        else print_sparse_matrix(sparse);
+        destroy_sparse_matrix(sparse);
+    } else failed = 1;
+    if (failed) printError(0);
+    free(degreeArray);
+    destroy_matrix(matrix);
+    if (report) stats_print(&run);
     return 0;
 }
@@ -1,23 +1,226 @@
 #ifndef SYMNMF_H
 #define SYMNMF_H
 
+#include <stddef.h>
+
+#define MATRIX_ALIGNMENT 64 /* Byte alignment of matrix storage (one cache line) */
+#define GEMM_ROW_BLOCK 64    /* Rows of A per task in multiply_matrices */
+#define GEMM_DEPTH_BLOCK 256 /* Rows of B kept in cache while a row block sweeps over them */
+#define SIM_BLOCK 64 /* Tile edge of the similarity construction */
+#define DEFAULT_NEIGHBORS 10 /* k of the sparse k-NN similarity graph */
+#define PARSE_CHUNK_BYTES (1 << 20) /* Smallest slice of the input handed to one parser thread */
+#define PRINT_BLOCK_BYTES (1 << 18) /* Approximate text formatted by one printer task */
+#define PRINT_FIELD_BYTES 400 /* Room reserved per printed number: %.4f of DBL_MAX is 316 chars */
+#define PRINT_FAST_LIMIT 1e9 /* Larger magnitudes are printed with snprintf */
+#define SCRATCH_NAME "symnmf-scratch-XXXXXX" /* mkstemp template of out-of-core W files */
+
+/* Binary matrix file: a BINARY_HEADER_BYTES header - BINARY_MAGIC (8 bytes), rows (8), cols (8),
+element size (4: BINARY_FLOAT64 or BINARY_FLOAT32) and 4 reserved zero bytes, integers
+little-endian - followed by the rows*cols elements, row-major, as little-endian IEEE floats. */
+#define BINARY_MAGIC "SYMNMFMX"
+#define BINARY_HEADER_BYTES 32
+#define BINARY_FLOAT64 8
+#define BINARY_FLOAT32 4
+
+/* SymNMF solvers (SolverOptions.solver) */
+#define SOLVER_MULTIPLICATIVE 0 /* H <- H o (1 - b + b W*H / (H*H^t*H)), b = 0.5 */
+#define SOLVER_MOMENTUM 1 /* The same update from a Nesterov extrapolation, restarted when the objective rises */
+#define SOLVER_PANLS 2 /* Penalized alternating nonnegative least squares, solved by HALS sweeps */
+#define DEFAULT_MAX_ITER 300
+#define DEFAULT_TOLERANCE 1e-4 /* Stop once the squared Frobenius norm of an update falls below it */
+
+typedef struct {
+    int solver;
+    int max_iter;
+    double tolerance;
+} SolverOptions;
+
+/* Instrumentation, compiled in with -DSYMNMF_STATS (make STATS=1, or SYMNMF_STATS=1 for setup.py): wall time,
+floating point operations of the main kernels and bytes of matrix storage per pipeline phase, plus the SymNMF
+updates and their squared Frobenius norms. The counters go to the SymnmfStats the calling thread attached with
+stats_attach (the multi-start and sweep workers inherit it), so concurrent calls each fill their own. Without the
+flag the STATS_ hooks compile to nothing. */
+#define STAT_LOAD 0
+#define STAT_SIMILARITY 1
+#define STAT_DEGREE 2
+#define STAT_NORMALIZE 3
+#define STAT_SYMNMF 4
+#define STAT_OUTPUT 5
+#define STAT_PHASES 6
+#define STAT_PHASE_NAMES {"load", "similarity", "degree", "normalize", "symnmf", "output"}
+#define STATS_HISTORY 1024 /* Update norms kept: the first ones */
+
+typedef struct {
+    double seconds[STAT_PHASES];
+    double flops[STAT_PHASES];
+    double bytes[STAT_PHASES]; /* Matrix storage allocated (heap and scratch mappings) */
+    long iterations; /* SymNMF updates, summed over runs */
+    int deltas_recorded;
+    double deltas[STATS_HISTORY]; /* ||H_new - H||_F^2 of the updates, in the order they finished */
+    double started[STAT_PHASES]; /* Bookkeeping of the open phases: when each opened, */
+    int depth[STAT_PHASES]; /* how many callers are inside it, */
+    int parent[STAT_PHASES]; /* the phase it was opened in */
+    int current; /* and the innermost one (-1 for none), which flops and bytes go to */
+} SymnmfStats;
+
+void stats_init(SymnmfStats* stats);
+SymnmfStats* stats_attach(SymnmfStats* stats);
+
+#ifdef SYMNMF_STATS
+void stats_begin(int phase);
+void stats_end(int phase);
+void stats_flops(double count);
+void stats_bytes(double count);
+void stats_iteration(double delta);
+#define STATS_BEGIN(phase) stats_begin(phase)
+#define STATS_END(phase) stats_end(phase)
+#define STATS_FLOPS(count) stats_flops((double)(count))
+#define STATS_BYTES(count) stats_bytes((double)(count))
+#define STATS_ITERATION(delta) stats_iteration(delta)
+#else
+#define STATS_BEGIN(phase) ((void)(phase))
+#define STATS_END(phase) ((void)(phase))
+#define STATS_FLOPS(count) ((void)0)
+#define STATS_BYTES(count) ((void)0)
+#define STATS_ITERATION(delta) ((void)0)
+#endif
+
+/* One run of perform_multi_start_symnmf or perform_symnmf_sweep: its H started from initialize_H after
+np.random.seed(seed) (for a warm started sweep, only the new column). */
+typedef struct {
+    unsigned long seed;
+    int iterations; /* updates done before converging or reaching max_iter */
+    double objective; /* ||W - H*H^t||_F at the end */
+} RestartStats;
+
+/* Dense row-major matrix kept in one aligned allocation. Element (i,j) lives at
+data[i*stride + j], stride (leading dimension) >= cols so a Matrix can also describe
+a padded buffer or a block of a bigger matrix. owner marks storage we must free (MATRIX_MAPPED:
+a scratch file mapping we must unmap). */
+typedef struct {
+    double* data;
+    int rows;
+    int cols;
+    int stride;
+    int owner;
+} Matrix;
+
+/* The same matrix over float elements, for the single precision kernels (the _f functions). */
+typedef struct {
+    float* data;
+    int rows;
+    int cols;
+    int stride;
+    int owner;
+} FloatMatrix;
+
+#define MATRIX_MAPPED 2
+
+#define MAT_ROW(m, i) ((m)->data + (size_t)(i) * (m)->stride)
+#define MAT(m, i, j) (MAT_ROW(m, i)[j])
+
+/* Upper triangle (diagonal included) of a symmetric n x n matrix, packed row by row:
+row i holds columns i..n-1. */
+typedef struct {
+    double* data;
+    int n;
+} PackedMatrix;
+
+typedef struct {
+    float* data;
+    int n;
+} FloatPackedMatrix;
+
+#define PACKED_SIZE(n) ((size_t)(n) * ((n) + 1) / 2)
+#define PACKED_OFFSET(n, i) ((size_t)(i) * (n) - (size_t)(i) * ((i) - 1) / 2)
+#define PACKED(p, i, j) ((p)->data[PACKED_OFFSET((p)->n, i) + (j) - (i)]) /* needs i <= j */
+
+/* Compressed sparse row matrix: row i holds values[row_start[i] .. row_start[i+1]) at columns
+col_index[...] (sorted ascending). owner marks arrays we must free. */
+typedef struct {
+    double* values;
+    int* col_index;
+    size_t* row_start;
+    int rows;
+    int cols;
+    int owner;
+} SparseMatrix;
+
 void printError(char quit);
 
+Matrix* create_matrix(int rows, int cols);
+Matrix* wrap_matrix(double* data, int rows, int cols, int stride);
+Matrix* create_scratch_matrix(int rows, int cols, const char* directory);
+void destroy_matrix(Matrix* matrix);
+double** matrix_row_pointers(const Matrix* matrix);
+PackedMatrix* create_packed_matrix(int n);
+void destroy_packed_matrix(PackedMatrix* packed);
+SparseMatrix* create_sparse_matrix(int rows, int cols, size_t nnz);
+void destroy_sparse_matrix(SparseMatrix* sparse);
+
+/* Compatibility shim: double** rows backed by a single contiguous block */
 double** allocate_matrix(int rows, int cols);
 void free_matrix(double** matrix, int rows);
 
 double squared_euclidean_distance(const double* a, const double* b, int d);
 
-double** compute_similarity_matrix(double** data, int n, int d);
-double* compute_degree_array(double** similarity, int n);
-double** compute_normalized_similarity(double** similarity, int n);
+int compute_similarity(const Matrix* data, Matrix* full, PackedMatrix* packed, double* degrees);
+Matrix* compute_similarity_matrix(const Matrix* data);
+PackedMatrix* compute_packed_similarity(const Matrix* data, double* degrees);
+double* compute_degree_array(const Matrix* similarity);
+int normalize_similarity(Matrix* full, PackedMatrix* packed, const double* degrees);
+Matrix* compute_normalized_similarity(const Matrix* similarity);
+int compute_normalized_rows(const Matrix* data, Matrix* W, const double* degrees);
+SparseMatrix* compute_sparse_similarity(const Matrix* data, int neighbors, double radius, double* degrees);
+int normalize_sparse_similarity(SparseMatrix* sparse, const double* degrees);
+int compute_silhouette(const Matrix* data, const int* labels, int labelings, const int* clusters, double* scores);
+int perform_kmeans(const Matrix* data, int k, int max_iter, double epsilon, int* labels);
+
+Matrix* perform_symnmf(const Matrix* W, Matrix* H, const SolverOptions* options);
+Matrix* perform_sparse_symnmf(const SparseMatrix* W, Matrix* H, const SolverOptions* options);
+Matrix* perform_out_of_core_symnmf(const Matrix* data, Matrix* H, const char* directory, const SolverOptions* options);
+Matrix* perform_matrix_free_symnmf(const Matrix* data, Matrix* H, const SolverOptions* options);
+Matrix* perform_multi_start_symnmf(const Matrix* W, Matrix* H, int restarts, unsigned long seed,
+                                   const SolverOptions* options, RestartStats* stats);
+Matrix* perform_sparse_multi_start_symnmf(const SparseMatrix* W, Matrix* H, int restarts, unsigned long seed,
+                                          const SolverOptions* options, RestartStats* stats);
+int perform_symnmf_sweep(const Matrix* W, Matrix** H, int k_min, int k_max, int warm_start, unsigned long seed,
+                         const SolverOptions* options, RestartStats* stats);
+void multiply_matrices(const Matrix* A, const Matrix* B, Matrix* C);
+void multiply_sparse_matrix(const SparseMatrix* A, const Matrix* B, Matrix* C);
+void compute_gram_matrix(const Matrix* A, Matrix* AtA);
+void multiply_matrix_by_its_transposed(const Matrix* A, Matrix* AxAt);
 
-double** perform_symnmf(double** W, double** H, int n, int k);
-void multiply_matrix_by_its_transposed(double** A,double** AxAt,int n,int k);
+/* Single precision variants, generated from the same source (symnmf_kernels.h) as the double ones */
+FloatMatrix* create_matrix_f(int rows, int cols);
+FloatMatrix* wrap_matrix_f(float* data, int rows, int cols, int stride);
+FloatMatrix* create_scratch_matrix_f(int rows, int cols, const char* directory);
+void destroy_matrix_f(FloatMatrix* matrix);
+int compute_similarity_f(const FloatMatrix* data, FloatMatrix* full, FloatPackedMatrix* packed, float* degrees);
+int normalize_similarity_f(FloatMatrix* full, FloatPackedMatrix* packed, const float* degrees);
+int compute_normalized_rows_f(const FloatMatrix* data, FloatMatrix* W, const float* degrees);
+FloatMatrix* perform_symnmf_f(const FloatMatrix* W, FloatMatrix* H, const SolverOptions* options);
+FloatMatrix* perform_sparse_symnmf_f(const SparseMatrix* W, FloatMatrix* H, const SolverOptions* options);
+FloatMatrix* perform_out_of_core_symnmf_f(const FloatMatrix* data, FloatMatrix* H, const char* directory, const SolverOptions* options);
+FloatMatrix* perform_matrix_free_symnmf_f(const FloatMatrix* data, FloatMatrix* H, const SolverOptions* options);
+FloatMatrix* perform_multi_start_symnmf_f(const FloatMatrix* W, FloatMatrix* H, int restarts, unsigned long seed,
+                                          const SolverOptions* options, RestartStats* stats);
+FloatMatrix* perform_sparse_multi_start_symnmf_f(const SparseMatrix* W, FloatMatrix* H, int restarts, unsigned long seed,
+                                                 const SolverOptions* options, RestartStats* stats);
+int perform_symnmf_sweep_f(const FloatMatrix* W, FloatMatrix** H, int k_min, int k_max, int warm_start, unsigned long seed,
+                           const SolverOptions* options, RestartStats* stats);
+void multiply_matrices_f(const FloatMatrix* A, const FloatMatrix* B, FloatMatrix* C);
+void multiply_sparse_matrix_f(const SparseMatrix* A, const FloatMatrix* B, FloatMatrix* C);
+void compute_gram_matrix_f(const FloatMatrix* A, FloatMatrix* AtA);
 
-void print_matrix(double** matrix, int row,int cols);
-double **read_matrix(const char *filename, int rows, int cols);
-int get_matrix_dimensions(const char *filename, int *rows, int *cols);
+void print_matrix(const Matrix* matrix);
+void print_packed_matrix(const PackedMatrix* packed);
+void print_sparse_matrix(const SparseMatrix* sparse);
+Matrix* read_matrix(const char *filename);
+int write_binary_matrix(const char* filename, const Matrix* matrix, int itemsize);
+int write_binary_packed(const char* filename, const PackedMatrix* packed, int itemsize);
+int write_binary_sparse(const char* filename, const SparseMatrix* sparse, int itemsize);
+int write_binary_diagonal(const char* filename, const double* values, int n, int itemsize);
 
 
 #endif
@@ -3,9 +3,29 @@ import numpy as np
 import symnmf
 
 
+BINARY_MAGIC = b"SYMNMFMX"  # Binary matrix file layout, see symnmf.h
+BINARY_HEADER = np.dtype([("magic", "S8"), ("rows", "<u8"), ("cols", "<u8"), ("itemsize", "<u4"), ("reserved", "<u4")])
+
+
+def read_binary(file_name):
+    """Maps a binary matrix file (as written by symnmf --binary/--float32) without parsing it. Params: file_name - name
+    of the file to read. Ret: read-only np.memmap of shape (rows, cols), float64 or float32."""
+    header = np.fromfile(file_name, dtype=BINARY_HEADER, count=1)
+    if len(header) == 0 or header["magic"][0] != BINARY_MAGIC:
+        raise ValueError
+    dtype = {8: "<f8", 4: "<f4"}.get(int(header["itemsize"][0]))
+    rows, cols = int(header["rows"][0]), int(header["cols"][0])
+    if dtype is None or rows == 0 or cols == 0:
+        raise ValueError
+    return np.memmap(file_name, dtype=dtype, mode="r", offset=BINARY_HEADER.itemsize, shape=(rows, cols))
+
 def read_input(file_name):
-    """Reads the input file and returns the data as a NumPy array. Params: file_name - name of the file to read. Ret: NumPy array."""
+    """Reads the input file and returns the data as a NumPy array. Binary matrix files are mapped, anything else is read
+    as CSV text. Params: file_name - name of the file to read. Ret: NumPy array."""
     try:
+        with open(file_name, "rb") as file:
+            if file.read(len(BINARY_MAGIC)) == BINARY_MAGIC:
+                return read_binary(file_name)
         txt = np.loadtxt(file_name, delimiter=",", dtype=np.float64)
         if len(txt) == 0:
             raise ValueError
@@ -20,20 +40,37 @@ def output_matrix(matrix):
 
 def initialize_H(W, k):
     """Initializes the matrix H for SymNMF. Params: W - similarity matrix, k - number of clusters. Ret: initialized
-    matrix H."""
+    matrix H, of W's dtype so a float32 W keeps SymNMF in single precision."""
     np.random.seed(1234)
     m = np.mean(W)
-    return np.random.uniform(0, 2 * np.sqrt(m / k), (W.shape[0], k))
+    return np.random.uniform(0, 2 * np.sqrt(m / k), (W.shape[0], k)).astype(W.dtype, copy=False)
+
+def parse_solver_flags(flags):
+    """Parses the optional solver flags after the positional arguments: --solver multiplicative|momentum|panls,
+    --tol <float>, --max-iter <int> and --restarts <int> (keep the best of that many seeds, 1234 onwards).
+    Params: flags - the remaining CMD args. Ret: dict of symnmf keyword arguments."""
+    names = {'--solver': ('solver', str), '--tol': ('tol', float), '--max-iter': ('max_iter', int),
+             '--restarts': ('restarts', int)}
+    if len(flags) % 2:
+        raise ValueError
+    options = {}
+    for flag, value in zip(flags[::2], flags[1::2]):
+        if flag not in names:
+            raise ValueError
+        name, parse = names[flag]
+        options[name] = parse(value)
+    return options
 
 def main():
     """Main function. Reads the input, performs the requested operation and prints the result. Params: CMD args. Ret: None."""
     try:
-        if len(sys.argv) != 4:
+        if len(sys.argv) < 4:
             raise ValueError
         
         k = int(sys.argv[1])
         goal = sys.argv[2]
         file_name = sys.argv[3]
+        options = parse_solver_flags(sys.argv[4:])
     
         X = read_input(file_name)
         if k >= X.shape[0]:
@@ -52,8 +89,11 @@ def main():
             if not k > 1:
                 raise ValueError
             W = symnmf.norm(X)  # Normalize similarity matrix first
-            H_init = initialize_H(W, k)
-            H_final = symnmf.symnmf(W, H_init)
+            if 'restarts' in options:  # Run 0 starts from initialize_H(W, k)
+                H_final, _ = symnmf.symnmf_restarts(W, k, **options)
+            else:
+                H_init = initialize_H(W, k)
+                H_final = symnmf.symnmf(W, H_init, **options)
             output_matrix(H_final)
         else:
             raise ValueError
@@ -0,0 +1,879 @@
+/* Type-generic dense kernels of symnmf.c. Not a standalone header: symnmf.c includes it once per
+element type after defining REAL (the element type), MATRIX and PACKED_MATRIX (the matching matrix
+types), EXP and SQRT (the math functions for REAL) and FN(name) (the function name for the type),
+which are undefined again at the end. The SymNMF update's convergence sum stays in double.*/
+
+/* Allocate a contiguous, MATRIX_ALIGNMENT aligned row-major matrix.
+Params: rows&cols - size. Ret: matrix (stride == cols), NULL on failure.*/
+MATRIX* FN(create_matrix)(int rows, int cols) {
+    MATRIX* matrix;
+    void* data = NULL;
+    size_t bytes = (size_t)rows * cols * sizeof(REAL);
+
+    if (rows < 0 || cols < 0) return NULL;
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, bytes ? bytes : sizeof(REAL)))
+        return NULL;
+    matrix = FN(wrap_matrix)((REAL*)data, rows, cols, cols);
+    if (!matrix) {
+        free(data);
+        return NULL;
+    }
+    matrix->owner = 1;
+    STATS_BYTES(bytes);
+    return matrix;
+}
+
+/* Describe existing storage as a matrix without copying (the storage is not freed with it).
+Params: data - first element, rows&cols - size, stride - elements between rows. Ret: matrix, NULL on failure.*/
+MATRIX* FN(wrap_matrix)(REAL* data, int rows, int cols, int stride) {
+    MATRIX* matrix = (MATRIX*)malloc(sizeof(MATRIX));
+    if (!matrix) return NULL;
+    matrix->data = data;
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = stride;
+    matrix->owner = 0;
+    return matrix;
+}
+
+/* Allocate a matrix in an unlinked scratch file, mapped shared so the kernel can page it out to disk: storage
+for an N x N W bigger than memory. Params: rows&cols - size, directory - where to create the file (NULL: $TMPDIR,
+else /tmp). Ret: matrix (stride == cols, owner MATRIX_MAPPED), NULL on failure.*/
+MATRIX* FN(create_scratch_matrix)(int rows, int cols, const char* directory) {
+    MATRIX* matrix;
+    void* data;
+    char* path;
+    int fd;
+    size_t bytes = (size_t)rows * cols * sizeof(REAL);
+
+    if (rows < 0 || cols < 0) return NULL;
+    if (!directory) directory = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+    path = (char*)malloc(strlen(directory) + sizeof(SCRATCH_NAME) + 1);
+    if (!path) return NULL;
+    sprintf(path, "%s/%s", directory, SCRATCH_NAME);
+    fd = mkstemp(path);
+    if (fd >= 0) unlink(path); /* The space is released once the mapping goes*/
+    free(path);
+    if (fd < 0) return NULL;
+    if (ftruncate(fd, (off_t)(bytes ? bytes : sizeof(REAL)))) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, bytes ? bytes : sizeof(REAL), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+    madvise(data, bytes ? bytes : sizeof(REAL), MADV_SEQUENTIAL); /* Streamed row block by row block*/
+    matrix = FN(wrap_matrix)((REAL*)data, rows, cols, cols);
+    if (!matrix) {
+        munmap(data, bytes ? bytes : sizeof(REAL));
+        return NULL;
+    }
+    matrix->owner = MATRIX_MAPPED;
+    STATS_BYTES(bytes);
+    return matrix;
+}
+
+/* Free a matrix (and its storage if it owns it). Params: matrix - may be NULL. Ret: None.*/
+void FN(destroy_matrix)(MATRIX* matrix) {
+    if (!matrix) return;
+    if (matrix->owner == MATRIX_MAPPED) {
+        size_t bytes = (size_t)matrix->rows * matrix->stride * sizeof(REAL);
+        munmap(matrix->data, bytes ? bytes : sizeof(REAL));
+    } else if (matrix->owner)
+        free(matrix->data);
+    free(matrix);
+}
+
+/* Squared row norms of data. Params: data - n x d matrix, norms - n outputs. Ret: None.*/
+static void FN(compute_row_norms)(const MATRIX* data, REAL* norms) {
+    int i, t;
+    for (i = 0; i < data->rows; i++) {
+        const REAL* row = MAT_ROW(data, i);
+        norms[i] = 0;
+        for (t = 0; t < data->cols; t++)
+            norms[i] += row[t] * row[t];
+    }
+}
+
+/* Compute the similarity matrix once per unordered pair, in SIM_BLOCK x SIM_BLOCK tiles of the upper
+triangle. Distances use |a|^2 + |b|^2 - 2a.b so each tile is a small dot product (GEMM) block. Row blocks
+are dealt to the threads round robin (a static schedule, so each thread's degree partials always sum the same
+terms in the same order) and the partials are added in thread order: the degrees, and everything computed from
+them, are the same on every run with the same thread count.
+Params: data - input matrix (n vectors of dimension d), full - n x n output or NULL, packed - packed
+output or NULL, degrees - n row sums (the degree array) or NULL. Ret: 0 on success, 1 on failure.*/
+int FN(compute_similarity)(const MATRIX* data, MATRIX* full, PACKED_MATRIX* packed, REAL* degrees) {
+    int i, j, t, ib, jb, n = data->rows, d = data->cols, threads = degrees ? THREAD_COUNT() : 0;
+    const int phase = full || packed ? STAT_SIMILARITY : STAT_DEGREE; /* Row sums only: the ddg pass*/
+    REAL* norms = (REAL*)malloc((n ? n : 1) * sizeof(REAL));
+    REAL* partial = threads ? (REAL*)calloc((size_t)threads * n + 1, sizeof(REAL)) : NULL;
+    if (!norms || (threads && !partial)) {
+        free(norms);
+        free(partial);
+        return 1;
+    }
+
+    STATS_BEGIN(phase);
+    FN(compute_row_norms)(data, norms);
+
+#pragma omp parallel private(i, j, t, jb)
+    {
+        REAL* local = partial ? partial + (size_t)THREAD_ID() * n : NULL; /* Per thread degree sums*/
+#pragma omp for schedule(static, 1)
+        for (ib = 0; ib < n; ib += SIM_BLOCK) {
+            int i_end = ib + SIM_BLOCK < n ? ib + SIM_BLOCK : n;
+            for (i = ib; i < i_end; i++) { /* Zero diagonal*/
+                if (full) MAT(full, i, i) = 0.0;
+                if (packed) PACKED(packed, i, i) = 0.0;
+            }
+            for (jb = ib; jb < n; jb += SIM_BLOCK) {
+                int j_end = jb + SIM_BLOCK < n ? jb + SIM_BLOCK : n;
+                for (i = ib; i < i_end; i++) {
+                    const REAL* row_i = MAT_ROW(data, i);
+                    for (j = (jb > i ? jb : i + 1); j < j_end; j++) {
+                        const REAL* row_j = MAT_ROW(data, j);
+                        REAL dot = 0, dist, value;
+                        for (t = 0; t < d; t++)
+                            dot += row_i[t] * row_j[t];
+                        dist = norms[i] + norms[j] - 2 * dot;
+                        value = EXP(-(dist > 0 ? dist : 0) / 2); /* Rounding can make dist slightly negative*/
+                        STORE_SIMILARITY(full, packed, local, i, j, value);
+                    }
+                }
+            }
+        }
+    }
+
+    if (degrees) { /* Reduce the per thread sums*/
+        for (i = 0; i < n; i++) {
+            degrees[i] = 0.0;
+            for (t = 0; t < threads; t++)
+                degrees[i] += partial[(size_t)t * n + i];
+        }
+    }
+    free(partial);
+    free(norms);
+    STATS_FLOPS((double)n * (n - 1) / 2 * (2 * d + 5));
+    STATS_END(phase);
+    return 0;
+}
+
+/* Scale a similarity matrix in place into D^-1/2 * A * D^-1/2, so no second n x n matrix is needed.
+Params: full - n x n similarity or NULL, packed - packed similarity or NULL, degrees - the row sums.
+Ret: 0 on success, 1 on failure.*/
+int FN(normalize_similarity)(MATRIX* full, PACKED_MATRIX* packed, const REAL* degrees) {
+    int i, j, n = full ? full->rows : packed->n;
+    REAL* inv_sqrt = (REAL*)malloc((n ? n : 1) * sizeof(REAL)); /* d^-1/2, 0 for isolated vectors*/
+    if (!inv_sqrt) return 1;
+
+    STATS_BEGIN(STAT_NORMALIZE);
+    for (i = 0; i < n; i++)
+        inv_sqrt[i] = degrees[i] > 0 ? 1 / SQRT(degrees[i]) : 0.0;
+
+#pragma omp parallel for private(j) schedule(dynamic, SIM_BLOCK)
+    for (i = 0; i < n; i++) {
+        const REAL scale = inv_sqrt[i];
+        if (full) {
+            REAL* row = MAT_ROW(full, i);
+            for (j = 0; j < n; j++)
+                row[j] *= scale * inv_sqrt[j];
+        }
+        if (packed) {
+            REAL* row = &PACKED(packed, i, i);
+            for (j = i; j < n; j++)
+                row[j - i] *= scale * inv_sqrt[j];
+        }
+    }
+    free(inv_sqrt);
+    STATS_FLOPS(full ? 2.0 * n * n : (double)n * (n + 1));
+    STATS_END(STAT_NORMALIZE);
+    return 0;
+}
+
+/* Write the normalized similarity D^-1/2 * A * D^-1/2 into W one block of SIM_BLOCK rows at a time, each
+block built from SIM_BLOCK x SIM_BLOCK tiles across all n columns. Both triangles are evaluated (twice the
+kernel work of compute_similarity), but every row is written once and in order, so W can be a scratch file
+mapping bigger than memory. The values are those of compute_similarity + normalize_similarity.
+Params: data - input matrix, W - n x n output, degrees - the row sums from compute_similarity.
+Ret: 0 on success, 1 on failure.*/
+int FN(compute_normalized_rows)(const MATRIX* data, MATRIX* W, const REAL* degrees) {
+    int i, j, t, ib, jb, n = data->rows, d = data->cols;
+    REAL* norms = (REAL*)malloc((n ? n : 1) * sizeof(REAL));
+    REAL* inv_sqrt = (REAL*)malloc((n ? n : 1) * sizeof(REAL)); /* d^-1/2, 0 for isolated vectors*/
+    if (!norms || !inv_sqrt) {
+        free(norms);
+        free(inv_sqrt);
+        return 1;
+    }
+    STATS_BEGIN(STAT_NORMALIZE);
+    FN(compute_row_norms)(data, norms);
+    for (i = 0; i < n; i++)
+        inv_sqrt[i] = degrees[i] > 0 ? 1 / SQRT(degrees[i]) : 0.0;
+
+#pragma omp parallel for private(i, j, t, jb) schedule(dynamic)
+    for (ib = 0; ib < n; ib += SIM_BLOCK) {
+        int i_end = ib + SIM_BLOCK < n ? ib + SIM_BLOCK : n;
+        for (jb = 0; jb < n; jb += SIM_BLOCK) {
+            int j_end = jb + SIM_BLOCK < n ? jb + SIM_BLOCK : n;
+            for (i = ib; i < i_end; i++) {
+                const REAL* row_i = MAT_ROW(data, i);
+                REAL* w = MAT_ROW(W, i);
+                for (j = jb; j < j_end; j++) {
+                    const REAL* row_j = MAT_ROW(data, j);
+                    REAL dot = 0, dist;
+                    if (j == i) {
+                        w[j] = 0.0;
+                        continue;
+                    }
+                    for (t = 0; t < d; t++)
+                        dot += row_i[t] * row_j[t];
+                    dist = norms[i] + norms[j] - 2 * dot;
+                    w[j] = (REAL)EXP(-(dist > 0 ? dist : 0) / 2) * (inv_sqrt[i] * inv_sqrt[j]);
+                }
+            }
+        }
+    }
+    free(inv_sqrt);
+    free(norms);
+    STATS_FLOPS((double)n * (n - 1) * (2 * d + 6));
+    STATS_END(STAT_NORMALIZE);
+    return 0;
+}
+
+/* C = A*B with a cache-blocked kernel, parallel over row blocks of A. Params: A - n x m,
+B - m x k, C - n x k result (must not alias A or B). Ret: None.*/
+void FN(multiply_matrices)(const MATRIX* A, const MATRIX* B, MATRIX* C) {
+    int ib, lb, i, l, j, n = A->rows, m = A->cols, k = B->cols;
+
+#pragma omp parallel for private(lb, i, l, j) schedule(dynamic)
+    for (ib = 0; ib < n; ib += GEMM_ROW_BLOCK) {
+        int i_end = ib + GEMM_ROW_BLOCK < n ? ib + GEMM_ROW_BLOCK : n;
+        for (i = ib; i < i_end; i++)
+            memset(MAT_ROW(C, i), 0, k * sizeof(REAL));
+        for (lb = 0; lb < m; lb += GEMM_DEPTH_BLOCK) { /* B rows [lb, l_end) stay in cache for the whole row block*/
+            int l_end = lb + GEMM_DEPTH_BLOCK < m ? lb + GEMM_DEPTH_BLOCK : m;
+            for (i = ib; i < i_end; i++) {
+                const REAL* a = MAT_ROW(A, i);
+                REAL* c = MAT_ROW(C, i);
+                for (l = lb; l < l_end; l++) {
+                    const REAL a_il = a[l];
+                    const REAL* b = MAT_ROW(B, l);
+                    for (j = 0; j < k; j++) /* Contiguous in both B and C*/
+                        c[j] += a_il * b[j];
+                }
+            }
+        }
+    }
+    STATS_FLOPS(2.0 * n * m * k);
+}
+
+/* Computes the k x k Gram matrix A^t*A of an n x k matrix. Every thread sums its static share of the rows into
+its own partial, and the partials are added in thread order (an OpenMP reduction would combine them in whatever
+order the threads finish), so the result is the same on every run with the same thread count. Params: A - the
+matrix, AtA - contiguous (stride == k) k x k matrix to hold the result. Ret: None.*/
+void FN(compute_gram_matrix)(const MATRIX* A, MATRIX* AtA) {
+    int i, a, b, t, n = A->rows, k = A->cols, threads = THREAD_COUNT();
+    REAL* gram = AtA->data;
+    REAL* partial = threads > 1 ? (REAL*)calloc((size_t)threads * k * k, sizeof(REAL)) : NULL;
+
+    memset(gram, 0, (size_t)k * k * sizeof(REAL));
+#pragma omp parallel private(i, a, b) if(partial != NULL)
+    {
+        REAL* local = partial ? partial + (size_t)THREAD_ID() * k * k : gram; /* Serial when there is no partial*/
+#pragma omp for schedule(static)
+        for (i = 0; i < n; i++) {
+            const REAL* row = MAT_ROW(A, i);
+            for (a = 0; a < k; a++)
+                for (b = a; b < k; b++) /* Symmetric, upper triangle only*/
+                    local[a * k + b] += row[a] * row[b];
+        }
+    }
+    for (t = 0; partial && t < threads; t++)
+        for (a = 0; a < k * k; a++)
+            gram[a] += partial[(size_t)t * k * k + a];
+    free(partial);
+    for (a = 1; a < k; a++) /* Mirror the lower triangle*/
+        for (b = 0; b < a; b++)
+            gram[a * k + b] = gram[b * k + a];
+    STATS_FLOPS((double)n * k * (k + 1));
+}
+
+/* C = A*B for a sparse A (SpMM), parallel over rows of A. Params: A - n x m CSR matrix, B - m x k,
+C - n x k result. Ret: None.*/
+void FN(multiply_sparse_matrix)(const SparseMatrix* A, const MATRIX* B, MATRIX* C) {
+    int i, j, k = B->cols;
+    size_t p;
+
+#pragma omp parallel for private(j, p) schedule(dynamic, GEMM_ROW_BLOCK)
+    for (i = 0; i < A->rows; i++) {
+        REAL* c = MAT_ROW(C, i);
+        memset(c, 0, k * sizeof(REAL));
+        for (p = A->row_start[i]; p < A->row_start[i + 1]; p++) {
+            const REAL a_ip = A->values[p];
+            const REAL* b = MAT_ROW(B, A->col_index[p]);
+            for (j = 0; j < k; j++)
+                c[j] += a_ip * b[j];
+        }
+    }
+    STATS_FLOPS(2.0 * A->row_start[A->rows] * k);
+}
+
+/* Where the SymNMF iterations get W*H from: a dense W, a sparse W, or (both NULL) W regenerated from the
+data tile by tile (matrix-free).*/
+typedef struct {
+    const MATRIX* dense;
+    const SparseMatrix* sparse;
+    const MATRIX* data; /* Matrix-free: the n input vectors, */
+    const REAL* norms; /* their squared norms, */
+    const REAL* inv_sqrt; /* the D^-1/2 diagonal */
+    REAL* tiles; /* and one SIM_BLOCK x SIM_BLOCK tile per thread*/
+} FN(SimilarityOperator);
+
+/* C = W*H with W = D^-1/2 * A * D^-1/2 regenerated from the data instead of read from memory: each SIM_BLOCK x
+SIM_BLOCK tile of squared distances is computed, passed through exp in one separate loop over the tile and folded
+into C right away. exp stays the scalar libm call (nothing vectorizes it at -O2), which keeps the W values those of
+compute_normalized_rows; with the order every row of C is summed in being that of multiply_matrices, C matches the
+dense product exactly.
+Params: W - matrix-free operator, H - n x k, C - n x k result. Ret: None.*/
+static void FN(multiply_kernel_tiles)(const FN(SimilarityOperator)* W, const MATRIX* H, MATRIX* C) {
+    int ib, jb, i, j, t, l, width, n = W->data->rows, d = W->data->cols, k = H->cols;
+
+#pragma omp parallel private(jb, i, j, t, l, width)
+    {
+        REAL* tile = W->tiles + (size_t)THREAD_ID() * SIM_BLOCK * SIM_BLOCK;
+#pragma omp for schedule(dynamic)
+        for (ib = 0; ib < n; ib += SIM_BLOCK) {
+            int i_end = ib + SIM_BLOCK < n ? ib + SIM_BLOCK : n;
+            for (i = ib; i < i_end; i++)
+                memset(MAT_ROW(C, i), 0, k * sizeof(REAL));
+            for (jb = 0; jb < n; jb += SIM_BLOCK) {
+                int j_end = jb + SIM_BLOCK < n ? jb + SIM_BLOCK : n;
+                width = j_end - jb;
+                for (i = ib; i < i_end; i++) { /* The tile's squared distances*/
+                    const REAL* row_i = MAT_ROW(W->data, i);
+                    REAL* out = tile + (size_t)(i - ib) * SIM_BLOCK;
+                    for (j = jb; j < j_end; j++) {
+                        const REAL* row_j = MAT_ROW(W->data, j);
+                        REAL dot = 0, dist;
+                        for (t = 0; t < d; t++)
+                            dot += row_i[t] * row_j[t];
+                        dist = W->norms[i] + W->norms[j] - 2 * dot;
+                        out[j - jb] = dist > 0 ? dist : 0; /* Rounding can make dist slightly negative*/
+                    }
+                    for (j = 0; j < width; j++)
+                        out[j] = EXP(-out[j] / 2);
+                }
+                for (i = ib; i < i_end; i++) { /* C rows += the tile's W values times H rows*/
+                    const REAL* w = tile + (size_t)(i - ib) * SIM_BLOCK;
+                    REAL* c = MAT_ROW(C, i);
+                    for (j = jb; j < j_end; j++) {
+                        const REAL* b = MAT_ROW(H, j);
+                        REAL w_ij;
+                        if (j == i) continue; /* Zero diagonal*/
+                        w_ij = w[j - jb] * (W->inv_sqrt[i] * W->inv_sqrt[j]);
+                        for (l = 0; l < k; l++)
+                            c[l] += w_ij * b[l];
+                    }
+                }
+            }
+        }
+    }
+    STATS_FLOPS((double)n * n * (2 * d + 2 * k + 6));
+}
+
+/* C = W*H for whichever form W comes in. Params: W - the operator, H - n x k, C - n x k result. Ret: None.*/
+static void FN(multiply_similarity)(const FN(SimilarityOperator)* W, const MATRIX* H, MATRIX* C) {
+    if (W->sparse) FN(multiply_sparse_matrix)(W->sparse, H, C); /* O(nnz k)*/
+    else if (W->dense) FN(multiply_matrices)(W->dense, H, C); /* O(n^2 k)*/
+    else FN(multiply_kernel_tiles)(W, H, C); /* O(n^2 (d + k)), no n x n storage*/
+}
+
+/* Bound on the spectral norm of W, the PANLS penalty weight: the largest row sum of the symmetric W. The
+matrix-free W has its row sums from one product with a matrix of ones, whose W values and summation order are those
+of the dense W, so all forms of one W get the same bound. Params: W - the operator, ones&sums - n x k scratch
+(matrix-free only). Ret: the bound.*/
+static double FN(similarity_bound)(const FN(SimilarityOperator)* W, MATRIX* ones, MATRIX* sums) {
+    double largest = 0;
+    size_t p;
+    int i, j;
+    if (W->sparse) {
+        for (i = 0; i < W->sparse->rows; i++) {
+            double sum = 0;
+            for (p = W->sparse->row_start[i]; p < W->sparse->row_start[i + 1]; p++)
+                sum += fabs(W->sparse->values[p]);
+            if (sum > largest) largest = sum;
+        }
+    } else if (W->dense) {
+#pragma omp parallel for private(j) reduction(max:largest) schedule(static)
+        for (i = 0; i < W->dense->rows; i++) {
+            const REAL* row = MAT_ROW(W->dense, i);
+            double sum = 0;
+            for (j = 0; j < W->dense->cols; j++)
+                sum += fabs(row[j]);
+            if (sum > largest) largest = sum;
+        }
+    } else {
+        for (i = 0; i < ones->rows; i++)
+            for (j = 0; j < ones->cols; j++)
+                MAT(ones, i, j) = 1;
+        FN(multiply_kernel_tiles)(W, ones, sums);
+        for (i = 0; i < sums->rows; i++)
+            if (MAT(sums, i, 0) > largest) largest = MAT(sums, i, 0);
+    }
+    return largest;
+}
+
+/* The multiplicative SymNMF iterations H <- H o (1 - b + b W*H / (H*H^t*H)). With SOLVER_MOMENTUM the update is
+taken from a Nesterov extrapolation Y = H + m (H - H_prev) instead of H, restarting the momentum whenever the
+objective ||W - Y*Y^t||^2 (known up to the constant ||W||^2 from the products already at hand) goes up. Y is kept at
+no less than half the new H (as far as one update could shrink it), so no entry hits 0 and sticks there.
+Params: W - where W*H comes from, H - n x k starting matrix, updated in place, options - solver settings,
+iterations - receives the number of updates done. Ret: H holding the final SymNMF matrix, NULL on failure.*/
+static MATRIX* FN(multiplicative_iterations)(const FN(SimilarityOperator)* W, MATRIX* H, const SolverOptions* options,
+                                             int* iterations) {
+    const REAL betta = 0.5; /* betta from the given formula */
+    const int momentum = options->solver == SOLVER_MOMENTUM;
+    double diff; /* squared Frobenius norm of the update*/
+    double objective, previous = HUGE_VAL, t = 1, t_next;
+    int i, j, iter, n = H->rows, k = H->cols; /* iterators and sizes */
+    MATRIX *WH, *HtH, *HHtH, *Y;
+    *iterations = 0;
+    if (n == 0) return H;
+    WH = FN(create_matrix)(n, k);
+    HHtH = FN(create_matrix)(n, k);
+    HtH = FN(create_matrix)(k, k);
+    Y = momentum ? FN(create_matrix)(n, k) : H; /* The point the update is taken from*/
+    if (!WH || !HHtH || !HtH || !Y) {
+        FN(destroy_matrix)(WH);
+        FN(destroy_matrix)(HHtH);
+        FN(destroy_matrix)(HtH);
+        if (Y != H) FN(destroy_matrix)(Y);
+        return NULL;
+    }
+    for (i = 0; momentum && i < n; i++)
+        memcpy(MAT_ROW(Y, i), MAT_ROW(H, i), k * sizeof(REAL));
+    for (iter = 0; iter < options->max_iter; iter++) {
+        REAL step = 0; /* momentum weight m*/
+        diff = 0;
+        FN(multiply_similarity)(W, Y, WH); /* numerator W*H*/
+        FN(compute_gram_matrix)(Y, HtH); /* H^t*H, O(n k^2)*/
+        FN(multiply_matrices)(Y, HtH, HHtH); /* denominator (H*H^t)*H == H*(H^t*H), O(n k^2)*/
+        if (momentum) {
+            objective = 0;
+#pragma omp parallel for private(j) reduction(+:objective) schedule(static)
+            for (i = 0; i < n; i++) /* -2 tr(Y^t W Y)*/
+                for (j = 0; j < k; j++)
+                    objective -= 2.0 * MAT(Y, i, j) * MAT(WH, i, j);
+            for (i = 0; i < k * k; i++) /* + ||Y^t Y||^2*/
+                objective += (double)HtH->data[i] * HtH->data[i];
+            if (objective > previous) t = 1; /* Restart*/
+            previous = objective;
+            t_next = (1 + sqrt(1 + 4 * t * t)) / 2;
+            step = (REAL)((t - 1) / t_next);
+            t = t_next;
+        }
+#pragma omp parallel for private(j) reduction(+:diff) schedule(static)
+        for (i = 0; i < n; i++) { /* Both products are done, so H can be updated in place*/
+            REAL* h = MAT_ROW(H, i);
+            REAL* y = MAT_ROW(Y, i);
+            const REAL* numerator = MAT_ROW(WH, i);
+            const REAL* denominator = MAT_ROW(HHtH, i);
+            for (j = 0; j < k; j++) {
+                REAL den = denominator[j] == 0 ? 1e-6 : denominator[j];
+                REAL updated = y[j] * (1 - betta + betta*numerator[j]/den); /* formula */
+                REAL previous_h = h[j];
+                diff += (updated - previous_h) * (updated - previous_h); /* squared Frobenius partial sum*/
+                h[j] = updated;
+                if (momentum) {
+                    y[j] = updated + step * (updated - previous_h);
+                    if (y[j] < (1 - betta) * updated) y[j] = (1 - betta) * updated;
+                }
+            }
+        }
+        STATS_FLOPS(7.0 * n * k);
+        STATS_ITERATION(diff);
+        if (diff < options->tolerance) break; /* Check convergence*/
+    }
+    *iterations = iter < options->max_iter ? iter + 1 : iter;
+    FN(destroy_matrix)(WH);
+    FN(destroy_matrix)(HHtH);
+    FN(destroy_matrix)(HtH);
+    if (Y != H) FN(destroy_matrix)(Y);
+    return H;
+}
+
+/* One HALS sweep of the penalized least squares min_{X>=0} ||W - X*Y^t||^2 + alpha ||X - Y||^2: every column r of X
+moves to its exact minimizer max(0, x_r + (R_r - X*M_r) / M_rr) given the others, where R = W*Y + alpha Y and
+M = Y^t*Y + alpha I. Rows are independent, so they run in parallel. Params: X - n x k, updated in place, WY - W*Y,
+Y - n x k, YtY - Y^t*Y, alpha - the penalty. Ret: squared Frobenius norm of the change in X.*/
+static double FN(hals_sweep)(MATRIX* X, const MATRIX* WY, const MATRIX* Y, const MATRIX* YtY, REAL alpha) {
+    double diff = 0;
+    int i, r, s, n = X->rows, k = X->cols;
+
+#pragma omp parallel for private(r, s) reduction(+:diff) schedule(static)
+    for (i = 0; i < n; i++) {
+        REAL* x = MAT_ROW(X, i);
+        const REAL* wy = MAT_ROW(WY, i);
+        const REAL* y = MAT_ROW(Y, i);
+        for (r = 0; r < k; r++) {
+            REAL residual = wy[r] + alpha * y[r] - alpha * x[r], updated;
+            REAL diagonal = MAT(YtY, r, r) + alpha;
+            for (s = 0; s < k; s++)
+                residual -= x[s] * MAT(YtY, s, r);
+            updated = diagonal > 0 ? x[r] + residual / diagonal : x[r];
+            if (updated < 0) updated = 0;
+            diff += (updated - x[r]) * (updated - x[r]);
+            x[r] = updated;
+        }
+    }
+    STATS_FLOPS((double)n * k * (2 * k + 10));
+    return diff;
+}
+
+/* Penalized alternating nonnegative least squares (PANLS) SymNMF: W ~ G*H^t with the penalty alpha ||G - H||^2,
+alpha a bound on ||W||_2, pulling the two factors together; G and H are solved for in turn by a HALS sweep each, two W
+products per iteration but far fewer iterations than the multiplicative update. Params: W - where W*H comes from,
+H - n x k starting matrix, updated in place, options - solver settings, iterations - receives the number of
+updates done. Ret: H holding the final SymNMF matrix, NULL on failure.*/
+static MATRIX* FN(panls_iterations)(const FN(SimilarityOperator)* W, MATRIX* H, const SolverOptions* options,
+                                    int* iterations) {
+    REAL alpha;
+    double diff;
+    int i, iter, n = H->rows, k = H->cols;
+    MATRIX *G, *WX, *XtX;
+    *iterations = 0;
+    if (n == 0) return H;
+    G = FN(create_matrix)(n, k);
+    WX = FN(create_matrix)(n, k);
+    XtX = FN(create_matrix)(k, k);
+    if (!G || !WX || !XtX) {
+        FN(destroy_matrix)(G);
+        FN(destroy_matrix)(WX);
+        FN(destroy_matrix)(XtX);
+        return NULL;
+    }
+    alpha = (REAL)FN(similarity_bound)(W, G, WX); /* G and WX are free until the first iteration*/
+    for (i = 0; i < n; i++)
+        memcpy(MAT_ROW(G, i), MAT_ROW(H, i), k * sizeof(REAL));
+    for (iter = 0; iter < options->max_iter; iter++) {
+        FN(multiply_similarity)(W, H, WX); /* G given H*/
+        FN(compute_gram_matrix)(H, XtX);
+        FN(hals_sweep)(G, WX, H, XtX, alpha);
+        FN(multiply_similarity)(W, G, WX); /* H given G*/
+        FN(compute_gram_matrix)(G, XtX);
+        diff = FN(hals_sweep)(H, WX, G, XtX, alpha);
+        STATS_ITERATION(diff);
+        if (diff < options->tolerance) break; /* Check convergence*/
+    }
+    *iterations = iter < options->max_iter ? iter + 1 : iter;
+    FN(destroy_matrix)(G);
+    FN(destroy_matrix)(WX);
+    FN(destroy_matrix)(XtX);
+    return H;
+}
+
+/* Run the selected SymNMF solver. Params: W - where W*H comes from, H - n x k starting matrix, updated in place,
+options - solver settings, NULL for the defaults, iterations - receives the number of updates done, or NULL.
+Ret: H holding the final SymNMF matrix, NULL on failure.*/
+static MATRIX* FN(symnmf_iterations)(const FN(SimilarityOperator)* W, MATRIX* H, const SolverOptions* options,
+                                     int* iterations) {
+    SolverOptions defaults;
+    MATRIX* result;
+    int done;
+    if (!options) {
+        defaults.solver = SOLVER_MULTIPLICATIVE;
+        defaults.max_iter = DEFAULT_MAX_ITER;
+        defaults.tolerance = DEFAULT_TOLERANCE;
+        options = &defaults;
+    }
+    if (!iterations) iterations = &done;
+    STATS_BEGIN(STAT_SYMNMF);
+    if (options->solver == SOLVER_PANLS) result = FN(panls_iterations)(W, H, options, iterations);
+    else result = FN(multiplicative_iterations)(W, H, options, iterations);
+    STATS_END(STAT_SYMNMF);
+    return result;
+}
+
+/* Perform the SymNMF algorithm. Params: W - n x n normalized similarity matrix, H - n x k starting
+matrix, updated in place, options - solver settings or NULL. Ret: H holding the final SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_symnmf)(const MATRIX* W, MATRIX* H, const SolverOptions* options) {
+    FN(SimilarityOperator) op;
+    memset(&op, 0, sizeof(op));
+    op.dense = W;
+    return FN(symnmf_iterations)(&op, H, options, NULL);
+}
+
+/* Perform the SymNMF algorithm with W kept out of core: the normalized similarity of data is written to a
+scratch file mapping row block by row block and the W*H products stream over it, so memory holds O(n k)
+plus whatever pages of W the kernel keeps cached. Params: data - n x d input, H - n x k starting matrix,
+updated in place, directory - scratch location (NULL: $TMPDIR, else /tmp), options - solver settings or NULL.
+Ret: H holding the final SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_out_of_core_symnmf)(const MATRIX* data, MATRIX* H, const char* directory,
+                                       const SolverOptions* options) {
+    int n = data->rows;
+    REAL* degrees = (REAL*)malloc((n ? n : 1) * sizeof(REAL));
+    MATRIX* W = degrees ? FN(create_scratch_matrix)(n, n, directory) : NULL;
+    MATRIX* result = NULL;
+
+    if (W && !FN(compute_similarity)(data, NULL, NULL, degrees) && !FN(compute_normalized_rows)(data, W, degrees))
+        result = FN(perform_symnmf)(W, H, options);
+    FN(destroy_matrix)(W);
+    free(degrees);
+    return result;
+}
+
+/* Perform the SymNMF algorithm on a sparse normalized similarity matrix. Params: W - n x n CSR matrix,
+H - n x k starting matrix, updated in place, options - solver settings or NULL. Ret: H holding the final
+SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_sparse_symnmf)(const SparseMatrix* W, MATRIX* H, const SolverOptions* options) {
+    FN(SimilarityOperator) op;
+    memset(&op, 0, sizeof(op));
+    op.sparse = W;
+    return FN(symnmf_iterations)(&op, H, options, NULL);
+}
+
+/* Perform the SymNMF algorithm matrix-free: only the degree vector is precomputed and every W*H regenerates
+the similarity tiles from data, trading n^2 memory traffic for kernel evaluations. Gives the same H as
+norm + perform_symnmf. Params: data - n x d input, H - n x k starting matrix, updated in place, options -
+solver settings or NULL. Ret: H holding the final SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_matrix_free_symnmf)(const MATRIX* data, MATRIX* H, const SolverOptions* options) {
+    int i, n = data->rows;
+    REAL* degrees = (REAL*)malloc((n ? n : 1) * sizeof(REAL));
+    REAL* norms = (REAL*)malloc((n ? n : 1) * sizeof(REAL));
+    REAL* tiles = (REAL*)malloc((size_t)THREAD_COUNT() * SIM_BLOCK * SIM_BLOCK * sizeof(REAL));
+    MATRIX* result = NULL;
+    FN(SimilarityOperator) op;
+
+    if (degrees && norms && tiles && !FN(compute_similarity)(data, NULL, NULL, degrees)) {
+        for (i = 0; i < n; i++) /* In place: degrees become d^-1/2, 0 for isolated vectors*/
+            degrees[i] = degrees[i] > 0 ? 1 / SQRT(degrees[i]) : 0.0;
+        FN(compute_row_norms)(data, norms);
+        memset(&op, 0, sizeof(op));
+        op.data = data;
+        op.norms = norms;
+        op.inv_sqrt = degrees;
+        op.tiles = tiles;
+        result = FN(symnmf_iterations)(&op, H, options, NULL);
+    }
+    free(degrees);
+    free(norms);
+    free(tiles);
+    return result;
+}
+
+/* Sum of n contiguous values in NumPy's pairwise order (8 accumulators over blocks of up to 128 values, halving
+above that), so np.mean(W) is reproduced bit for bit. Params: a - the values, n - how many. Ret: the sum.*/
+static REAL FN(pairwise_sum)(const REAL* a, size_t n) {
+    REAL r[8], sum = 0;
+    size_t i, j, half;
+    if (n < 8) {
+        for (i = 0; i < n; i++)
+            sum += a[i];
+        return sum;
+    }
+    if (n > 128) {
+        half = n / 2;
+        half -= half % 8;
+        return FN(pairwise_sum)(a, half) + FN(pairwise_sum)(a + half, n - half);
+    }
+    for (j = 0; j < 8; j++)
+        r[j] = a[j];
+    for (i = 8; i < n - n % 8; i += 8)
+        for (j = 0; j < 8; j++)
+            r[j] += a[i + j];
+    sum = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+/* Fill columns first.. of H as symnmf.py's initialize_H fills all of them after np.random.seed(seed): uniform in
+[0, 2 sqrt(mean(W) / k)), row by row. Params: H - n x k, first - first column to fill (0 for initialize_H), mean -
+mean of W, seed - the seed. Ret: None.*/
+static void FN(seed_H)(MATRIX* H, int first, REAL mean, unsigned long seed) {
+    MersenneTwister mt;
+    const double high = 2 * SQRT(mean / (REAL)H->cols);
+    int i, j;
+
+    mt_seed(&mt, seed);
+    for (i = 0; i < H->rows; i++)
+        for (j = first; j < H->cols; j++)
+            MAT(H, i, j) = (REAL)(high * mt_random_sample(&mt));
+}
+
+/* ||W - H*H^t||_F from ||W||_F^2 - 2 tr(H^t*W*H) + ||H^t*H||_F^2. Params: W - the operator, squared_norm - ||W||_F^2,
+H - n x k, WH&HtH - n x k and k x k scratch. Ret: the objective.*/
+static double FN(symnmf_objective)(const FN(SimilarityOperator)* W, double squared_norm, const MATRIX* H, MATRIX* WH,
+                                   MATRIX* HtH) {
+    double objective = squared_norm;
+    int i, j, k = H->cols;
+
+    FN(multiply_similarity)(W, H, WH);
+    FN(compute_gram_matrix)(H, HtH);
+    for (i = 0; i < H->rows; i++)
+        for (j = 0; j < k; j++)
+            objective -= 2.0 * MAT(H, i, j) * MAT(WH, i, j);
+    for (i = 0; i < k * k; i++)
+        objective += (double)HtH->data[i] * HtH->data[i];
+    return objective > 0 ? sqrt(objective) : 0;
+}
+
+/* One recorded SymNMF run of the multi-start and sweep drivers: columns first.. of H are seeded (the others
+already hold a warm start), then H is iterated and its objective taken. Params: W - the operator, mean&squared_norm -
+mean and ||W||_F^2 of W, H - n x k, updated in place, first&seed - as seed_H, options - solver settings or NULL,
+stats - receives the run. Ret: 0 on success, 1 on failure.*/
+static int FN(recorded_run)(const FN(SimilarityOperator)* W, REAL mean, double squared_norm, MATRIX* H, int first,
+                            unsigned long seed, const SolverOptions* options, RestartStats* stats) {
+    MATRIX* WH;
+    MATRIX* HtH;
+    int failed;
+
+    STATS_BEGIN(STAT_SYMNMF); /* The objective's product counts as SymNMF work too*/
+    WH = FN(create_matrix)(H->rows, H->cols);
+    HtH = FN(create_matrix)(H->cols, H->cols);
+    failed = !WH || !HtH;
+    stats->seed = seed;
+    stats->iterations = 0;
+    stats->objective = HUGE_VAL;
+    if (!failed) {
+        FN(seed_H)(H, first, mean, seed);
+        failed = !FN(symnmf_iterations)(W, H, options, &stats->iterations);
+    }
+    if (!failed) stats->objective = FN(symnmf_objective)(W, squared_norm, H, WH, HtH);
+    FN(destroy_matrix)(WH);
+    FN(destroy_matrix)(HtH);
+    STATS_END(STAT_SYMNMF);
+    return failed;
+}
+
+/* R SymNMF runs of one W, run r starting from the seed + r initialize_H. With R > 1 the runs go one per thread
+(each run's own kernels then serial), sharing the read-only W. The run of lowest objective, the first on ties, is
+kept in H. Params: W - the operator, mean&squared_norm - mean and ||W||_F^2 of W, H - n x k result, restarts - R,
+seed - first seed, options - solver settings or NULL, stats - R entries to fill, or NULL. Ret: H, NULL on failure.*/
+static MATRIX* FN(multi_start_iterations)(const FN(SimilarityOperator)* W, REAL mean, double squared_norm, MATRIX* H,
+                                          int restarts, unsigned long seed, const SolverOptions* options,
+                                          RestartStats* stats) {
+    int r, i, best = -1, failed = restarts < 1, n = H->rows, k = H->cols;
+    double best_objective = HUGE_VAL;
+
+#pragma omp parallel for private(i) schedule(dynamic) if(restarts > 1) copyin(stats_sink)
+    for (r = 0; r < restarts; r++) {
+        MATRIX* run = FN(create_matrix)(n, k);
+        RestartStats record;
+        int run_failed = 1;
+
+        record.seed = (seed + r) & 0xffffffffUL;
+        record.iterations = 0;
+        record.objective = HUGE_VAL;
+        if (run) run_failed = FN(recorded_run)(W, mean, squared_norm, run, 0, record.seed, options, &record);
+        if (stats) stats[r] = record;
+#pragma omp critical(symnmf_best_run)
+        {
+            if (run_failed) failed = 1;
+            else if (record.objective < best_objective || (record.objective == best_objective && r < best)) {
+                best_objective = record.objective;
+                best = r;
+                for (i = 0; i < n; i++)
+                    memcpy(MAT_ROW(H, i), MAT_ROW(run, i), k * sizeof(REAL));
+            }
+        }
+        FN(destroy_matrix)(run);
+    }
+    return failed ? NULL : H;
+}
+
+/* Mean (summed in np.mean's order) and squared Frobenius norm of a dense W. Params: W - n x n, mean&squared_norm -
+receive them. Ret: None.*/
+static void FN(dense_moments)(const MATRIX* W, REAL* mean, double* squared_norm) {
+    double squares = 0;
+    REAL sum = 0;
+    int i, j, n = W->rows;
+
+    if (W->stride == W->cols) sum = FN(pairwise_sum)(W->data, (size_t)n * n);
+    else for (i = 0; i < n; i++) sum += FN(pairwise_sum)(MAT_ROW(W, i), n);
+#pragma omp parallel for private(j) reduction(+:squares) schedule(static)
+    for (i = 0; i < n; i++) {
+        const REAL* row = MAT_ROW(W, i);
+        for (j = 0; j < n; j++)
+            squares += (double)row[j] * row[j];
+    }
+    *mean = n ? sum / (REAL)((double)n * n) : 0;
+    *squared_norm = squares;
+}
+
+/* Multi-start SymNMF: R runs of perform_symnmf from the initialize_H of seeds seed, seed + 1, ..., keeping the
+best by ||W - H*H^t||_F. Params: W - n x n normalized similarity matrix, H - n x k result, restarts - R >= 1,
+seed - first seed, options - solver settings or NULL, stats - R entries describing the runs, or NULL.
+Ret: H holding the best SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_multi_start_symnmf)(const MATRIX* W, MATRIX* H, int restarts, unsigned long seed,
+                                       const SolverOptions* options, RestartStats* stats) {
+    FN(SimilarityOperator) op;
+    double squared_norm;
+    REAL mean;
+
+    FN(dense_moments)(W, &mean, &squared_norm);
+    memset(&op, 0, sizeof(op));
+    op.dense = W;
+    return FN(multi_start_iterations)(&op, mean, squared_norm, H, restarts, seed, options, stats);
+}
+
+/* SymNMF of one W for every k in k_min..k_max. Cold starts (each k from the initialize_H of seed, what a run per k
+would do) go one k per thread; warm starts go in order of k, each H starting from the previous k's H plus one new
+column seeded with seed + k. Params: W - n x n normalized similarity matrix, H - k_max - k_min + 1 results, the j-th
+n x (k_min + j), warm_start - which of the two, seed - seed of the initialize_H starts, options - solver settings or
+NULL, stats - an entry per k, or NULL. Ret: 0 on success, 1 on failure.*/
+int FN(perform_symnmf_sweep)(const MATRIX* W, MATRIX** H, int k_min, int k_max, int warm_start, unsigned long seed,
+                             const SolverOptions* options, RestartStats* stats) {
+    FN(SimilarityOperator) op;
+    RestartStats record;
+    double squared_norm;
+    REAL mean;
+    int i, j, first, failed = k_min < 1 || k_max < k_min;
+    if (failed) return 1;
+
+    FN(dense_moments)(W, &mean, &squared_norm);
+    memset(&op, 0, sizeof(op));
+    op.dense = W;
+    if (!warm_start) {
+#pragma omp parallel for private(record) reduction(|:failed) schedule(dynamic) if(k_max > k_min) copyin(stats_sink)
+        for (j = k_max - k_min; j >= 0; j--) { /* Largest k, the slowest, first*/
+            failed |= FN(recorded_run)(&op, mean, squared_norm, H[j], 0, seed, options, &record);
+            if (stats) stats[j] = record;
+        }
+        return failed;
+    }
+    for (j = 0; j <= k_max - k_min && !failed; j++) {
+        first = j ? H[j - 1]->cols : 0;
+        for (i = 0; first && i < W->rows; i++)
+            memcpy(MAT_ROW(H[j], i), MAT_ROW(H[j - 1], i), first * sizeof(REAL));
+        failed = FN(recorded_run)(&op, mean, squared_norm, H[j], first, j ? (seed + H[j]->cols) & 0xffffffffUL : seed,
+                                  options, &record);
+        if (stats) stats[j] = record;
+    }
+    return failed;
+}
+
+/* Multi-start SymNMF of a sparse W, started from the mean of its dense equivalent. Params: W - n x n CSR matrix,
+the rest as perform_multi_start_symnmf. Ret: H holding the best SymNMF matrix, NULL on failure.*/
+MATRIX* FN(perform_sparse_multi_start_symnmf)(const SparseMatrix* W, MATRIX* H, int restarts, unsigned long seed,
+                                              const SolverOptions* options, RestartStats* stats) {
+    FN(SimilarityOperator) op;
+    double sum = 0, squared_norm = 0;
+    size_t p, nnz = W->row_start[W->rows];
+
+    for (p = 0; p < nnz; p++) {
+        sum += W->values[p];
+        squared_norm += W->values[p] * W->values[p];
+    }
+    memset(&op, 0, sizeof(op));
+    op.sparse = W;
+    return FN(multi_start_iterations)(&op, W->rows ? (REAL)(sum / ((double)W->rows * W->rows)) : 0, squared_norm, H,
+                                      restarts, seed, options, stats);
+}
+
+#undef REAL
+#undef MATRIX
+#undef PACKED_MATRIX
+#undef EXP
+#undef SQRT
+#undef FN
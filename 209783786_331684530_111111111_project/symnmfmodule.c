@@ -5,17 +5,60 @@
 #include <numpy/arrayobject.h>
 
 /* Function declarations for Python module*/
-static PyObject* py_sym(PyObject* self, PyObject* args);
-static PyObject* py_ddg(PyObject* self, PyObject* args);
-static PyObject* py_norm(PyObject* self, PyObject* args);
-static PyObject* py_symnmf(PyObject* self, PyObject* args);
+static PyObject* py_sym(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_ddg(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_norm(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_symnmf(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_symnmf_out_of_core(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_symnmf_matrix_free(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_symnmf_restarts(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_symnmf_sweep(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_silhouette(PyObject* self, PyObject* args, PyObject* kwargs);
+static PyObject* py_kmeans(PyObject* self, PyObject* args, PyObject* kwargs);
 
 /* Method table for Python module*/
 static PyMethodDef SymnmfMethods[] = {
-    {"sym", py_sym, METH_VARARGS, "Calculate the similarity matrix."},
-    {"ddg", py_ddg, METH_VARARGS, "Calculate the diagonal degree matrix."},
-    {"norm", py_norm, METH_VARARGS, "Calculate the normalized similarity matrix."},
-    {"symnmf", py_symnmf, METH_VARARGS, "Perform symmetric Non-negative Matrix Factorization."},
+    {"sym", (PyCFunction)(void(*)(void))py_sym, METH_VARARGS | METH_KEYWORDS,
+        "Calculate the similarity matrix. sym(X, out=None, stats=False)."},
+    {"ddg", (PyCFunction)(void(*)(void))py_ddg, METH_VARARGS | METH_KEYWORDS,
+        "Calculate the diagonal degree matrix. ddg(X, out=None, stats=False)."},
+    {"norm", (PyCFunction)(void(*)(void))py_norm, METH_VARARGS | METH_KEYWORDS,
+        "Calculate the normalized similarity matrix. norm(X, knn=0, radius=0.0, out=None, stats=False): with knn and/or"
+        " radius set, returns the sparse k-NN / radius graph as a CSR tuple (data, indices, indptr)."},
+    {"symnmf", (PyCFunction)(void(*)(void))py_symnmf, METH_VARARGS | METH_KEYWORDS,
+        "Perform symmetric Non-negative Matrix Factorization. symnmf(W, H, out=None, solver=\"multiplicative\", tol=1e-4,"
+        " max_iter=300, stats=False): W is a dense matrix or a CSR tuple (data, indices, indptr) from norm(X, knn=...),"
+        " out=H updates H in place. solver is \"multiplicative\", \"momentum\" (Nesterov-accelerated multiplicative) or \"panls\""
+        " (penalized alternating nonnegative least squares); iterations stop when ||H_new - H||^2 < tol."},
+    {"symnmf_out_of_core", (PyCFunction)(void(*)(void))py_symnmf_out_of_core, METH_VARARGS | METH_KEYWORDS,
+        "Perform SymNMF of norm(X) without holding W in memory. symnmf_out_of_core(X, H, scratch=None, out=None,"
+        " solver=\"multiplicative\", tol=1e-4, max_iter=300, stats=False):"
+        " W is written to an unlinked file in the scratch directory ($TMPDIR or /tmp by default) and streamed every iteration."},
+    {"symnmf_matrix_free", (PyCFunction)(void(*)(void))py_symnmf_matrix_free, METH_VARARGS | METH_KEYWORDS,
+        "Perform SymNMF of norm(X) without storing W at all. symnmf_matrix_free(X, H, out=None,"
+        " solver=\"multiplicative\", tol=1e-4, max_iter=300, stats=False): only the degrees are"
+        " kept, W*H regenerates the similarity tiles from X every iteration. Same result as symnmf(norm(X), H)."},
+    {"symnmf_restarts", (PyCFunction)(void(*)(void))py_symnmf_restarts, METH_VARARGS | METH_KEYWORDS,
+        "Perform SymNMF from several starting points and keep the best. symnmf_restarts(W, k, restarts=8, seed=1234,"
+        " solver=\"multiplicative\", tol=1e-4, max_iter=300, stats=False): run r starts from symnmf.py's initialize_H"
+        " after np.random.seed(seed + r); the runs share W and go in parallel. Returns (H, stats): the H of lowest"
+        " ||W - H*H^t||_F and a dict of per-run arrays seed, iterations and objective, plus best (the kept run)."},
+    {"symnmf_sweep", (PyCFunction)(void(*)(void))py_symnmf_sweep, METH_VARARGS | METH_KEYWORDS,
+        "Perform SymNMF of norm(X) for every k in a range, building W once. symnmf_sweep(X, k_min, k_max,"
+        " warm_start=False, seed=1234, solver=\"multiplicative\", tol=1e-4, max_iter=300, stats=False): cold starts run"
+        " every k in parallel from initialize_H after np.random.seed(seed), warm starts run k in order from the previous H plus"
+        " one new column. Returns (Hs, stats): the list of H for k_min..k_max and a dict of per-k arrays k, seed,"
+        " iterations and objective (||W - H*H^t||_F)."},
+    {"silhouette", (PyCFunction)(void(*)(void))py_silhouette, METH_VARARGS | METH_KEYWORDS,
+        "Mean silhouette coefficient (Euclidean) of a clustering of X. silhouette(X, labels): labels holds non negative"
+        " cluster indices, one per row of X, or is a 2D array / list of several such labelings scored in one pass over"
+        " the distances (returns an array then). Labels need not be consecutive; like sklearn, a labeling must use 2 to"
+        " n - 1 clusters or ValueError is raised. Non integer labels raise TypeError, negative ones or ones from"
+        " 2^31 - 1 up raise ValueError."},
+    {"kmeans", (PyCFunction)(void(*)(void))py_kmeans, METH_VARARGS | METH_KEYWORDS,
+        "k-means clustering of X with kmeans.py's semantics. kmeans(X, k, max_iter=300, epsilon=1e-4): starts from the"
+        " first k rows, stops once every centroid moved less than epsilon or after max_iter rounds. Returns the int32"
+        " labels of the last assignment, the same as kmeans.k_means."},
     {NULL, NULL, 0, NULL}  /* Sentinel*/
 };
 
@@ -23,7 +66,12 @@ static PyMethodDef SymnmfMethods[] = {
 static struct PyModuleDef symnmfmodule = {
     PyModuleDef_HEAD_INIT,
     "symnmf",
-    "Python interface for Symmetric Non-negative Matrix Factorization.",
+    "Python interface for Symmetric Non-negative Matrix Factorization.\n\n"
+    "With stats=True, sym, ddg, norm and the symnmf functions also return the instrumentation of that call, appended"
+    " to their result: (result, stats), or (H, runs, stats) and (Hs, runs, stats) for symnmf_restarts and"
+    " symnmf_sweep. stats is a dict of per-phase dicts (similarity, degree, normalize, symnmf) seconds, flops, gflops"
+    " and bytes (matrix storage allocated), plus iterations (SymNMF updates) and deltas (||H_new - H||^2 of the first"
+    " 1024 updates); it is None unless the module was built with SYMNMF_STATS=1.",
     -1,
     SymnmfMethods
 };
@@ -34,204 +82,574 @@ PyMODINIT_FUNC PyInit_symnmf(void) {
     return PyModule_Create(&symnmfmodule);
 }
 
-/* Function for converting the given NumPy array into a workable 2d double array. Params: np_arr - python nparray object. Ret: NULL on failure.*/
-double** numpy_to_double_array(PyArrayObject* np_arr) {
-    int rows = (int) PyArray_DIM(np_arr, 0); /* Get dims*/
-    int cols = (int) PyArray_DIM(np_arr, 1);
+/* Function for checking whether two memory spans (end NULL when empty) overlap. Params: a&b - the spans. Ret: 1 if they do.*/
+static int spans_overlap(const void* a, const void* a_end, const void* b, const void* b_end) {
+    if (!a_end || !b_end) return 0; /* Empty*/
+    return (const char*)a < (const char*)b_end && (const char*)b < (const char*)a_end;
+}
 
-    double** c_array = (double**) malloc(rows * sizeof(double*)); /* Allocate memory for row arrays*/
-    if (!c_array) return NULL;
+/* Whether two matrices of the same element type share any memory*/
+#define MATRIX_END(m) ((m)->rows && (m)->cols ? (const void*)(MAT_ROW(m, (m)->rows - 1) + (m)->cols) : NULL)
+#define matrices_overlap(a, b) spans_overlap((a)->data, MATRIX_END(a), (b)->data, MATRIX_END(b))
 
-    for (int i = 0; i < rows; i++) { /* For each row*/
-        c_array[i] = (double*) malloc(cols * sizeof(double)); /* Allocate*/
-        if (!c_array[i]) {
-            for (int j = 0; j < i; j++) free(c_array[j]);
-            free(c_array);
-            return NULL;
-        }
-        
-        for (int j = 0; j < cols; j++)
-            c_array[i][j] = *(double*)PyArray_GETPTR2(np_arr, i, j); /* Copy data */
-    }
-    return c_array;
+/* Function for checking that an argument is a 2D array of real numbers. Params: array - the array. Ret: 1 if it is.*/
+static int is_real_matrix(PyArrayObject* array) {
+    return PyArray_NDIM(array) == 2 && PyTypeNum_ISNUMBER(PyArray_TYPE(array)) && !PyTypeNum_ISCOMPLEX(PyArray_TYPE(array));
 }
 
-/* Function for expanding the vector of diagonal values to a full matrix. Params: degreeVector - array of degrees, n - size. Ret: full matrix, NULL on failure.*/
-double ** expand_degree_vector_to_matrix(double* degreeVector, int n){
-    double** degreeMatrix = allocate_matrix(n,n);
-    if (!degreeMatrix) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed.");
+/* float32 arrays are computed in single precision by the _f kernels, everything else in double*/
+#define IS_FLOAT32(array) (PyArray_TYPE((PyArrayObject*)(array)) == NPY_FLOAT32)
+
+/* Function for viewing a CSR tuple (data, indices, indptr) as a SparseMatrix, borrowing the arrays when they already
+have the right type. Params: tuple - the python object, n - expected rows&cols, keep - receives the 3 arrays holding
+the data (Py_XDECREF them when done). Ret: NULL on failure (python error set).*/
+SparseMatrix* borrow_csr_tuple(PyObject* tuple, int n, PyArrayObject* keep[3]) {
+    PyArrayObject *values = NULL, *indices = NULL, *indptr = NULL;
+    SparseMatrix* sparse = NULL;
+
+    if (PyTuple_Size(tuple) == 3) {
+        values = (PyArrayObject*)PyArray_FROM_OTF(PyTuple_GET_ITEM(tuple, 0), NPY_FLOAT64, NPY_ARRAY_IN_ARRAY);
+        indices = values ? (PyArrayObject*)PyArray_FROM_OTF(PyTuple_GET_ITEM(tuple, 1), NPY_INT32, NPY_ARRAY_IN_ARRAY) : NULL;
+        indptr = indices ? (PyArrayObject*)PyArray_FROM_OTF(PyTuple_GET_ITEM(tuple, 2), NPY_INTP, NPY_ARRAY_IN_ARRAY) : NULL;
+    }
+    keep[0] = values;
+    keep[1] = indices;
+    keep[2] = indptr;
+    if (!indptr || PyArray_NDIM(values) != 1 || PyArray_NDIM(indices) != 1 || PyArray_NDIM(indptr) != 1
+        || PyArray_DIM(indptr, 0) != n + 1 || PyArray_DIM(values, 0) != PyArray_DIM(indices, 0)) {
+        PyErr_Clear();
+        PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
         return NULL;
     }
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++)
-            degreeMatrix[i][j] = i == j ? degreeVector[i] : 0.0; /* Value if on diagonal, 0 if not*/
+    npy_intp nnz = PyArray_DIM(values, 0);
+    const npy_intp* starts = (const npy_intp*)PyArray_DATA(indptr);
+    const int* cols = (const int*)PyArray_DATA(indices);
+    int valid = starts[0] == 0 && starts[n] == nnz;
+    for (int i = 0; i < n && valid; i++) /* Rows must be in order and columns in range*/
+        valid = starts[i] <= starts[i + 1];
+    for (npy_intp p = 0; p < nnz && valid; p++)
+        valid = cols[p] >= 0 && cols[p] < n;
+    if (!valid) {
+        PyErr_SetString(PyExc_ValueError, "Invalid CSR matrix.");
+        return NULL;
     }
-    return degreeMatrix;
-}
 
-int convert_arg_ndarray_to_matrix(PyObject* args, double*** out_data, int* out_rows, int* out_cols) {
-    PyArrayObject* input_array;
-
-    if (!PyArg_ParseTuple(args, "O!", &PyArray_Type, &input_array)) {/* Parse Python arguments */
-        PyErr_SetString(PyExc_TypeError, "Parsing Python arguments failed.");
-        return 0; /* 0 means error */
+    sparse = (SparseMatrix*)malloc(sizeof(SparseMatrix));
+    if (!sparse) {
+        PyErr_NoMemory();
+        return NULL;
     }
+    sparse->values = (double*)PyArray_DATA(values);
+    sparse->col_index = (int*)PyArray_DATA(indices);
+    sparse->row_start = (size_t*)PyArray_DATA(indptr); /* npy_intp and size_t share a representation for these non negative offsets*/
+    sparse->rows = sparse->cols = n;
+    sparse->owner = 0;
+    return sparse;
+}
 
-    if (PyArray_NDIM(input_array) != 2 || PyArray_TYPE(input_array) != NPY_FLOAT64) { /* Ensure it's a 2D float64 array */
-        PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
-        return 0; /* 0 means error */
+/* Function for packaging a SparseMatrix as a CSR tuple (data, indices, indptr) of NumPy arrays
+(scipy.sparse.csr_matrix accepts it as is). Params: sparse - the matrix. Ret - the tuple, NULL on failure.*/
+static PyObject* packageSparse(const SparseMatrix* sparse) {
+    npy_intp nnz = (npy_intp)sparse->row_start[sparse->rows], rows = sparse->rows + 1;
+    PyArrayObject* values = (PyArrayObject*) PyArray_SimpleNew(1, &nnz, NPY_FLOAT64);
+    PyArrayObject* indices = (PyArrayObject*) PyArray_SimpleNew(1, &nnz, NPY_INT32);
+    PyArrayObject* indptr = (PyArrayObject*) PyArray_SimpleNew(1, &rows, NPY_INTP);
+    if (!values || !indices || !indptr) {
+        Py_XDECREF(values);
+        Py_XDECREF(indices);
+        Py_XDECREF(indptr);
+        return NULL;
     }
 
+    memcpy(PyArray_DATA(values), sparse->values, nnz * sizeof(double));
+    memcpy(PyArray_DATA(indices), sparse->col_index, nnz * sizeof(int));
+    for (npy_intp i = 0; i < rows; i++)
+        ((npy_intp*)PyArray_DATA(indptr))[i] = (npy_intp)sparse->row_start[i];
+    return Py_BuildValue("(NNN)", values, indices, indptr);
+}
 
-    int rows = (int) PyArray_DIM(input_array, 0); /* Get dims*/
-    int cols = (int) PyArray_DIM(input_array, 1);
+/* Function for packaging the runs of a multi-start SymNMF or a sweep as a dict of per-run arrays (seed, iterations,
+objective). Params: stats - the runs, runs - how many. Ret: the dict, NULL on failure.*/
+static PyObject* package_run_stats(const RestartStats* stats, int runs) {
+    npy_intp count = runs;
+    PyArrayObject* seeds = (PyArrayObject*) PyArray_SimpleNew(1, &count, NPY_UINT32);
+    PyArrayObject* iterations = (PyArrayObject*) PyArray_SimpleNew(1, &count, NPY_INT32);
+    PyArrayObject* objectives = (PyArrayObject*) PyArray_SimpleNew(1, &count, NPY_FLOAT64);
+    if (!seeds || !iterations || !objectives) {
+        Py_XDECREF(seeds);
+        Py_XDECREF(iterations);
+        Py_XDECREF(objectives);
+        return NULL;
+    }
 
-    double** data = numpy_to_double_array(input_array);
-    if (!data) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed in numpy_to_double_array.");
-        return 0; /* 0 means error */
+    for (int r = 0; r < runs; r++) {
+        ((npy_uint32*)PyArray_DATA(seeds))[r] = (npy_uint32)stats[r].seed;
+        ((npy_int32*)PyArray_DATA(iterations))[r] = stats[r].iterations;
+        ((double*)PyArray_DATA(objectives))[r] = stats[r].objective;
     }
+    return Py_BuildValue("{sNsNsN}", "seed", seeds, "iterations", iterations, "objective", objectives);
+}
 
-    *out_data = data;
-    
-    *out_rows = rows;
-    *out_cols = cols;
-    return 1;  /* 1 means success */
+#ifdef SYMNMF_STATS
+/* Function for building a dict of one counter per phase. Params: values - STAT_PHASES values. Ret: new dict, NULL on failure.*/
+static PyObject* phase_dict(const double* values) {
+    static const char* names[] = STAT_PHASE_NAMES;
+    PyObject* dict = PyDict_New();
+    for (int phase = 0; dict && phase < STAT_PHASES; phase++) {
+        PyObject* value = PyFloat_FromDouble(values[phase]);
+        if (!value || PyDict_SetItemString(dict, names[phase], value)) Py_CLEAR(dict);
+        Py_XDECREF(value);
+    }
+    return dict;
 }
+#endif
+
+/* Function for packaging the counters of one call as the stats dict (None without SYMNMF_STATS).
+Params: stats - the counters. Ret: the dict, NULL on failure.*/
+static PyObject* package_stats(const SymnmfStats* stats) {
+#ifdef SYMNMF_STATS
+    double gflops[STAT_PHASES];
+    for (int phase = 0; phase < STAT_PHASES; phase++)
+        gflops[phase] = stats->seconds[phase] > 0 ? stats->flops[phase] / stats->seconds[phase] * 1e-9 : 0.0;
+    npy_intp recorded = stats->deltas_recorded;
+    PyObject* seconds = phase_dict(stats->seconds);
+    PyObject* flops = phase_dict(stats->flops);
+    PyObject* rates = phase_dict(gflops);
+    PyObject* bytes = phase_dict(stats->bytes);
+    PyArrayObject* deltas = (PyArrayObject*)PyArray_SimpleNew(1, &recorded, NPY_FLOAT64);
+    if (!seconds || !flops || !rates || !bytes || !deltas) {
+        Py_XDECREF(seconds);
+        Py_XDECREF(flops);
+        Py_XDECREF(rates);
+        Py_XDECREF(bytes);
+        Py_XDECREF(deltas);
+        return NULL;
+    }
 
-/* Function for packaging the 2d double array to a NumPy array. Params: data - matrix. rows&cols - size. Ret - the packaged NumPy object.*/
-static PyObject* packageArray(double** data, int rows, int cols) {
-    npy_intp dims[2] = {rows, cols}; /*Init dimensions*/
-    PyArrayObject* output_array = (PyArrayObject*) PyArray_SimpleNew(2, dims, NPY_FLOAT64); /*Initialize output array*/
+    memcpy(PyArray_DATA(deltas), stats->deltas, recorded * sizeof(double));
+    return Py_BuildValue("{sNsNsNsNslsN}", "seconds", seconds, "flops", flops, "gflops", rates, "bytes", bytes,
+                         "iterations", stats->iterations, "deltas", deltas);
+#else
+    (void)stats;
+    Py_RETURN_NONE;
+#endif
+}
 
-    for (int i = 0; i < rows; i++) { /*Copy array*/
-        for (int j = 0; j < cols; j++) {
-            *(double*)PyArray_GETPTR2(output_array, i, j) = data[i][j];
-        }
+/* Function for starting the stats= instrumentation of a call: everything the call runs (on this thread and the
+workers it starts) counts into a SymnmfStats of its own. Params: wanted - the stats argument, stats - receives the
+counters, NULL when not wanted. Ret: 1 on success, 0 on failure (python error set).*/
+static int open_call_stats(int wanted, SymnmfStats** stats) {
+    *stats = NULL;
+    if (!wanted) return 1;
+    *stats = (SymnmfStats*)malloc(sizeof(SymnmfStats));
+    if (!*stats) {
+        PyErr_NoMemory();
+        return 0;
     }
-    return PyArray_Return(output_array);
+    stats_init(*stats);
+    stats_attach(*stats);
+    return 1;
 }
 
-/* Bridge to sym function. Ret : NULL on failure (Will raise a python error)*/
-static PyObject* py_sym(PyObject* self, PyObject* args) {
-    int rows, cols;
-    double** data;
-    if (!convert_arg_ndarray_to_matrix(args, &data, &rows, &cols))
+/* Function for finishing a call started by open_call_stats: the counters are detached and, when they were wanted,
+appended to the result. Params: stats - the counters or NULL, result - the call's result (NULL on failure), extend -
+whether result is a tuple to append to rather than wrap as (result, stats). Ret: the final result, NULL on failure.*/
+static PyObject* close_call_stats(SymnmfStats* stats, PyObject* result, int extend) {
+    if (!stats) return result;
+    stats_attach(NULL);
+    PyObject* packaged = result ? package_stats(stats) : NULL;
+    free(stats);
+    if (!packaged) {
+        Py_XDECREF(result);
         return NULL;
+    }
 
-    double** similarity = compute_similarity_matrix(data, rows,cols);
-    free_matrix(data, rows); /* No need for it any more */
-    if (!similarity) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for similarity matrix.");
+    if (!extend) return Py_BuildValue("(NN)", result, packaged);
+    PyObject* last = PyTuple_Pack(1, packaged);
+    PyObject* combined = last ? PySequence_Concat(result, last) : NULL;
+    Py_XDECREF(last);
+    Py_DECREF(packaged);
+    Py_DECREF(result);
+    return combined;
+}
+
+/* The bridges, instantiated once per element type from symnmfmodule_bridges.h*/
+#define REAL double
+#define MATRIX Matrix
+#define NPY_REAL NPY_FLOAT64
+#define REAL_NAME "float64"
+#define FN(name) name
+#include "symnmfmodule_bridges.h"
+
+#define REAL float
+#define MATRIX FloatMatrix
+#define NPY_REAL NPY_FLOAT32
+#define REAL_NAME "float32"
+#define FN(name) name##_f
+#include "symnmfmodule_bridges.h"
+
+/* Bridge to the sparse norm function. Params: data - input, knn&radius - graph parameters. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* sparse_norm(const Matrix* data, int knn, double radius) {
+    int rows = data->rows;
+    double* degrees = (double*)malloc((rows ? rows : 1) * sizeof(double));
+    SparseMatrix* sparse = NULL;
+    int failed = 1;
+    if (degrees) {
+        Py_BEGIN_ALLOW_THREADS
+        sparse = compute_sparse_similarity(data, knn, radius, degrees);
+        failed = !sparse || normalize_sparse_similarity(sparse, degrees);
+        Py_END_ALLOW_THREADS
+    }
+    free(degrees);
+    if (failed) {
+        destroy_sparse_matrix(sparse);
+        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for sparse similarity matrix.");
         return NULL;
     }
 
-    PyObject* packagedResult = packageArray(similarity, rows, rows);
+    PyObject* packagedResult = packageSparse(sparse);
 
-    free_matrix(similarity, rows);
+    destroy_sparse_matrix(sparse);
 
     return packagedResult;
 }
 
-/* Bridge to dgg function. Ret : NULL on failure (Will raise a python error)*/
-static PyObject* py_ddg(PyObject* self, PyObject* args) {
-    int rows, cols;
-    double** data;
-    if (!convert_arg_ndarray_to_matrix(args, &data, &rows, &cols))
+
+/* Function for the common X (and out, stats) arguments of sym/ddg. Params: args&kwargs - python arguments, input_array
+- X, out - out= argument or NULL, stats - the stats argument. Ret: 1 on success, 0 on failure (python error set).*/
+static int parse_data_args(PyObject* args, PyObject* kwargs, PyArrayObject** input_array, PyObject** out, int* stats) {
+    static char* kwlist[] = {"X", "out", "stats", NULL};
+
+    *out = NULL;
+    *stats = 0;
+    return PyArg_ParseTupleAndKeywords(args, kwargs, "O!|Op", kwlist, &PyArray_Type, input_array, out, stats);
+}
+
+/* Bridge to sym function. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_sym(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyArrayObject* input_array;
+    PyObject* out;
+    SymnmfStats* stats;
+    int want_stats;
+    if (!parse_data_args(args, kwargs, &input_array, &out, &want_stats) || !open_call_stats(want_stats, &stats))
         return NULL;
-    
-    double** similarity = compute_similarity_matrix(data, rows,cols);
-    free_matrix(data, rows); /* No need for it any more */
-    if (!similarity) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for similarity matrix.");
+    return close_call_stats(stats, IS_FLOAT32(input_array) ? sym_bridge_f(input_array, out)
+                                                           : sym_bridge(input_array, out), 0);
+}
+
+/* Bridge to dgg function. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_ddg(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyArrayObject* input_array;
+    PyObject* out;
+    SymnmfStats* stats;
+    int want_stats;
+    if (!parse_data_args(args, kwargs, &input_array, &out, &want_stats) || !open_call_stats(want_stats, &stats))
         return NULL;
-    }
+    return close_call_stats(stats, IS_FLOAT32(input_array) ? ddg_bridge_f(input_array, out)
+                                                           : ddg_bridge(input_array, out), 0);
+}
 
-    double* dgg = compute_degree_array(similarity, rows);
-    free_matrix(similarity, rows); /* No need for it any more */
-    if (!dgg) return NULL;
 
-    double** expandedDegreeMatrix = expand_degree_vector_to_matrix(dgg,rows); 
-    free(dgg); /* No need for it any more */
-    if (!expandedDegreeMatrix) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for diagonal matrix.");
+/* Bridge to norm sym function. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_norm(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "knn", "radius", "out", "stats", NULL};
+    PyArrayObject *input_array, *input;
+    PyObject *result, *out = NULL;
+    int knn = 0, want_stats = 0;
+    double radius = 0;
+    Matrix* data;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!|idOp", kwlist, &PyArray_Type, &input_array, &knn, &radius, &out,
+                                     &want_stats))
+        return NULL;
+    if (knn < 0 || radius < 0) {
+        PyErr_SetString(PyExc_ValueError, "knn and radius must be non negative.");
+        return NULL;
+    }
+    if ((knn || radius > 0) && out && out != Py_None) {
+        PyErr_SetString(PyExc_ValueError, "out is not supported for the sparse graph.");
         return NULL;
     }
+    if (!open_call_stats(want_stats, &stats))
+        return NULL;
+    if (!knn && radius <= 0)
+        result = IS_FLOAT32(input_array) ? norm_bridge_f(input_array, out) : norm_bridge(input_array, out);
+    else if (convert_ndarray_to_matrix(input_array, &data, &input)) { /* The sparse graph is built in double*/
+        result = sparse_norm(data, knn, radius);
+        destroy_matrix(data);
+        Py_DECREF(input);
+    } else
+        result = NULL;
+    return close_call_stats(stats, result, 0);
+}
 
-    PyObject* packagedResult = packageArray(expandedDegreeMatrix, rows, rows);
+/* Function for the solver=, tol= and max_iter= arguments of the symnmf functions. Params: solver - solver name,
+tolerance&max_iter - stopping rule, options - filled in. Ret: 1 on success, 0 on failure (python error set).*/
+static int parse_solver_options(const char* solver, double tolerance, int max_iter, SolverOptions* options) {
+    if (!strcmp(solver, "multiplicative")) options->solver = SOLVER_MULTIPLICATIVE;
+    else if (!strcmp(solver, "momentum")) options->solver = SOLVER_MOMENTUM;
+    else if (!strcmp(solver, "panls")) options->solver = SOLVER_PANLS;
+    else {
+        PyErr_SetString(PyExc_ValueError, "solver must be \"multiplicative\", \"momentum\" or \"panls\".");
+        return 0;
+    }
+    if (tolerance < 0 || max_iter < 0) {
+        PyErr_SetString(PyExc_ValueError, "tol and max_iter must be non negative.");
+        return 0;
+    }
+    options->tolerance = tolerance;
+    options->max_iter = max_iter;
+    return 1;
+}
 
-    free_matrix(expandedDegreeMatrix, rows);
+/* Bridge to nsymnmf function. W and H both float32 (or a CSR W with a float32 H) run in single precision.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_symnmf(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"W", "H", "out", "solver", "tol", "max_iter", "stats", NULL};
+    PyObject *array1, *out = NULL;
+    PyArrayObject* array2;
+    const char* solver = "multiplicative";
+    double tolerance = DEFAULT_TOLERANCE;
+    int max_iter = DEFAULT_MAX_ITER, want_stats = 0;
+    SolverOptions options;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO!|Osdip", kwlist, &array1, &PyArray_Type, &array2, &out, &solver,
+                                     &tolerance, &max_iter, &want_stats)) /* Parse Python arguments */
+        return NULL;
+    if (!parse_solver_options(solver, tolerance, max_iter, &options))
+        return NULL;
+    int sparse_input = PyTuple_Check(array1); /* CSR tuple from norm(X, knn=...)*/
 
-    return packagedResult;
+    if (!sparse_input && (!PyArray_Check(array1) || PyArray_NDIM((PyArrayObject*)array1) != 2)) { /* Ensure W is a 2D array */
+        PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
+        return NULL;
+    }
+    if (!open_call_stats(want_stats, &stats))
+        return NULL;
+    if (IS_FLOAT32(array2) && (sparse_input || IS_FLOAT32(array1)))
+        return close_call_stats(stats, symnmf_bridge_f(array1, array2, out, &options), 0);
+    return close_call_stats(stats, symnmf_bridge(array1, array2, out, &options), 0);
 }
 
-/* Bridge to norm sym function. Ret : NULL on failure (Will raise a python error)*/
-static PyObject* py_norm(PyObject* self, PyObject* args) {
-    int rows, cols;
-    double** data;
-    if (!convert_arg_ndarray_to_matrix(args, &data, &rows, &cols))
+/* Bridge to the out-of-core symnmf function. X and H both float32 run in single precision (half the scratch file).
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_symnmf_out_of_core(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "H", "scratch", "out", "solver", "tol", "max_iter", "stats", NULL};
+    PyArrayObject *input_array, *array2;
+    const char *scratch = NULL, *solver = "multiplicative";
+    PyObject* out = NULL;
+    double tolerance = DEFAULT_TOLERANCE;
+    int max_iter = DEFAULT_MAX_ITER, want_stats = 0;
+    SolverOptions options;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!|zOsdip", kwlist, &PyArray_Type, &input_array, &PyArray_Type,
+                                     &array2, &scratch, &out, &solver, &tolerance, &max_iter, &want_stats))
+        return NULL;
+    if (!parse_solver_options(solver, tolerance, max_iter, &options) || !open_call_stats(want_stats, &stats))
         return NULL;
+    if (IS_FLOAT32(input_array) && IS_FLOAT32(array2))
+        return close_call_stats(stats, data_symnmf_bridge_f(input_array, array2, 0, scratch, out, &options), 0);
+    return close_call_stats(stats, data_symnmf_bridge(input_array, array2, 0, scratch, out, &options), 0);
+}
 
-    double** similarity = compute_similarity_matrix(data, rows,cols);
-    free_matrix(data, rows); /* No need for it any more */
-    if (!similarity) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for similarity matrix.");
+/* Bridge to the matrix-free symnmf function. X and H both float32 run in single precision.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_symnmf_matrix_free(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "H", "out", "solver", "tol", "max_iter", "stats", NULL};
+    PyArrayObject *input_array, *array2;
+    PyObject* out = NULL;
+    const char* solver = "multiplicative";
+    double tolerance = DEFAULT_TOLERANCE;
+    int max_iter = DEFAULT_MAX_ITER, want_stats = 0;
+    SolverOptions options;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O!|Osdip", kwlist, &PyArray_Type, &input_array, &PyArray_Type,
+                                     &array2, &out, &solver, &tolerance, &max_iter, &want_stats))
         return NULL;
-    }
+    if (!parse_solver_options(solver, tolerance, max_iter, &options) || !open_call_stats(want_stats, &stats))
+        return NULL;
+    if (IS_FLOAT32(input_array) && IS_FLOAT32(array2))
+        return close_call_stats(stats, data_symnmf_bridge_f(input_array, array2, 1, NULL, out, &options), 0);
+    return close_call_stats(stats, data_symnmf_bridge(input_array, array2, 1, NULL, out, &options), 0);
+}
 
-    double** normsym = compute_normalized_similarity(similarity, rows);
-    free_matrix(similarity, rows); /* No need for it any more */
-    if (!normsym) {
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for normalized similarity matrix.");
+/* Bridge to the multi-start symnmf function. A float32 W runs in single precision, a CSR W in double.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_symnmf_restarts(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"W", "k", "restarts", "seed", "solver", "tol", "max_iter", "stats", NULL};
+    PyObject* array1;
+    int k, restarts = 8, max_iter = DEFAULT_MAX_ITER, want_stats = 0;
+    unsigned long seed = 1234;
+    const char* solver = "multiplicative";
+    double tolerance = DEFAULT_TOLERANCE;
+    SolverOptions options;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|iksdip", kwlist, &array1, &k, &restarts, &seed, &solver,
+                                     &tolerance, &max_iter, &want_stats))
+        return NULL;
+    if (!parse_solver_options(solver, tolerance, max_iter, &options))
+        return NULL;
+    if (restarts < 1) {
+        PyErr_SetString(PyExc_ValueError, "restarts must be positive.");
+        return NULL;
+    }
+    if (!PyTuple_Check(array1) && (!PyArray_Check(array1) || PyArray_NDIM((PyArrayObject*)array1) != 2)) {
+        PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
         return NULL;
     }
+    if (!open_call_stats(want_stats, &stats))
+        return NULL;
+    if (!PyTuple_Check(array1) && IS_FLOAT32(array1))
+        return close_call_stats(stats, restarts_bridge_f(array1, k, restarts, seed, &options), 1);
+    return close_call_stats(stats, restarts_bridge(array1, k, restarts, seed, &options), 1);
+}
 
-    PyObject* packagedResult = packageArray(normsym, rows, rows);
+/* Bridge to the symnmf sweep function. A float32 X runs in single precision.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_symnmf_sweep(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "k_min", "k_max", "warm_start", "seed", "solver", "tol", "max_iter", "stats", NULL};
+    PyArrayObject* input_array;
+    int k_min, k_max, warm_start = 0, max_iter = DEFAULT_MAX_ITER, want_stats = 0;
+    unsigned long seed = 1234;
+    const char* solver = "multiplicative";
+    double tolerance = DEFAULT_TOLERANCE;
+    SolverOptions options;
+    SymnmfStats* stats;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!ii|pksdip", kwlist, &PyArray_Type, &input_array, &k_min, &k_max,
+                                     &warm_start, &seed, &solver, &tolerance, &max_iter, &want_stats))
+        return NULL;
+    if (!parse_solver_options(solver, tolerance, max_iter, &options) || !open_call_stats(want_stats, &stats))
+        return NULL;
+    if (IS_FLOAT32(input_array))
+        return close_call_stats(stats, sweep_bridge_f(input_array, k_min, k_max, warm_start, seed, &options), 1);
+    return close_call_stats(stats, sweep_bridge(input_array, k_min, k_max, warm_start, seed, &options), 1);
+}
 
-    free_matrix(normsym, rows);
+/* qsort/bsearch comparator of labels.*/
+static int compare_labels(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
 
-    return packagedResult;
+/* Function for renumbering a labeling to the dense ids 0..c-1 in order of label value, as np.unique(labels,
+return_inverse=True) does, so the kernel's work follows the cluster count rather than the largest label.
+Params: labels - n labels, renumbered in place, scratch - n ints. Ret: c, the number of distinct labels.*/
+static int dense_labels(int* labels, int* scratch, int n) {
+    int c = 0;
+    memcpy(scratch, labels, n * sizeof(int));
+    qsort(scratch, n, sizeof(int), compare_labels);
+    for (int i = 0; i < n; i++)
+        if (!c || scratch[i] != scratch[c - 1]) scratch[c++] = scratch[i];
+    for (int i = 0; i < n; i++)
+        labels[i] = (int)((int*)bsearch(labels + i, scratch, c, sizeof(int), compare_labels) - scratch);
+    return c;
 }
 
-/* Bridge to nsymnmf function. Ret : NULL on failure (Will raise a python error)*/
-static PyObject* py_symnmf(PyObject* self, PyObject* args) {
-    PyArrayObject *array1, *array2;
-    if (!PyArg_ParseTuple(args, "O!O!", &PyArray_Type, &array1, &PyArray_Type, &array2)) {/* Parse Python arguments */
-        PyErr_SetString(PyExc_TypeError, "Parsing Python arguments failed.");
+/* Bridge to the silhouette function. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_silhouette(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "labels", NULL};
+    PyArrayObject *input_array, *input, *label_array, *scores = NULL;
+    PyObject* labels_arg;
+    Matrix* data;
+    int failed = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!O", kwlist, &PyArray_Type, &input_array, &labels_arg))
+        return NULL;
+    PyArrayObject* given = (PyArrayObject*)PyArray_FROM_O(labels_arg); /* Any integer type, checked before the cast*/
+    if (!given)
+        return NULL;
+    if (!PyArray_ISINTEGER(given)) {
+        Py_DECREF(given);
+        PyErr_SetString(PyExc_TypeError, "labels must be integers.");
+        return NULL;
+    }
+    int is_unsigned = PyArray_ISUNSIGNED(given); /* Safe casts only: unsigned labels widen to uint64, signed to int64*/
+    label_array = (PyArrayObject*)PyArray_FROM_OTF((PyObject*)given, is_unsigned ? NPY_UINT64 : NPY_INT64, NPY_ARRAY_IN_ARRAY);
+    Py_DECREF(given);
+    if (!label_array)
+        return NULL;
+    if (!convert_ndarray_to_matrix(input_array, &data, &input)) {
+        Py_DECREF(label_array);
         return NULL;
     }
 
-    if (PyArray_NDIM(array1) != 2 || PyArray_TYPE(array1) != NPY_FLOAT64 ||    /* Ensure both are 2D float64 arrays */
-        PyArray_NDIM(array2) != 2 || PyArray_TYPE(array2) != NPY_FLOAT64) {
-            PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
-            return NULL;
+    int single = PyArray_NDIM(label_array) == 1, n = data->rows;
+    int labelings = PyArray_NDIM(label_array) == 2 ? (int)PyArray_DIM(label_array, 0) : 1;
+    const npy_int64* signed_labels = (const npy_int64*)PyArray_DATA(label_array);
+    const npy_uint64* unsigned_labels = (const npy_uint64*)PyArray_DATA(label_array);
+    int* labels = (int*)malloc(((size_t)labelings * n + 1) * sizeof(int));
+    int* scratch = (int*)malloc(((size_t)n + 1) * sizeof(int));
+    int* clusters = (int*)calloc(labelings ? labelings : 1, sizeof(int));
+    npy_intp count = labelings;
+    if (PyArray_NDIM(label_array) < 1 || PyArray_NDIM(label_array) > 2 || PyArray_DIM(label_array, PyArray_NDIM(label_array) - 1) != n)
+        PyErr_SetString(PyExc_ValueError, "labels must hold one label per row of X.");
+    else if (!labels || !scratch || !clusters || !(scores = (PyArrayObject*)PyArray_SimpleNew(1, &count, NPY_FLOAT64)))
+        PyErr_NoMemory();
+    for (npy_intp p = 0; scores && p < (npy_intp)labelings * n; p++) {
+        if (is_unsigned ? unsigned_labels[p] >= INT_MAX : signed_labels[p] < 0 || signed_labels[p] >= INT_MAX) {
+            PyErr_SetString(PyExc_ValueError, "labels must be non negative and below 2^31 - 1.");
+            break;
+        }
+        labels[p] = is_unsigned ? (int)unsigned_labels[p] : (int)signed_labels[p];
+    }
+    for (int l = 0; scores && !PyErr_Occurred() && l < labelings; l++) { /* sklearn's 2 <= clusters <= n - 1*/
+        clusters[l] = dense_labels(labels + (size_t)l * n, scratch, n);
+        if (clusters[l] < 2 || clusters[l] > n - 1)
+            PyErr_Format(PyExc_ValueError, "labels use %d clusters, the silhouette needs 2 to n - 1 (%d).", clusters[l],
+                         n - 1);
+    }
+    if (scores && !PyErr_Occurred()) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = compute_silhouette(data, labels, labelings, clusters, (double*)PyArray_DATA(scores));
+        Py_END_ALLOW_THREADS
+        if (failed) PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for silhouette.");
+    }
+    free(labels);
+    free(scratch);
+    free(clusters);
+    destroy_matrix(data);
+    Py_DECREF(input);
+    Py_DECREF(label_array);
+    if (failed) {
+        Py_XDECREF(scores);
+        return NULL;
     }
 
-    int rows = (int) PyArray_DIM(array1, 0); /* N from W */
-    int cols = (int) PyArray_DIM(array2, 1); /* k from H */
+    if (!single)
+        return (PyObject*)scores;
+    PyObject* score = PyFloat_FromDouble(*(double*)PyArray_DATA(scores));
+    Py_DECREF(scores);
+    return score;
+}
 
-    double** c_array1 = numpy_to_double_array(array1); /* Convert NumPy arrays to C double** */
-    double** c_array2 = numpy_to_double_array(array2);
-    if (!c_array1 || !c_array2) {
-        if (c_array1) free_matrix(c_array1, rows);
-        if (c_array2) free_matrix(c_array2, rows);
-        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed.");
+/* Bridge to the k-means function. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* py_kmeans(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"X", "k", "max_iter", "epsilon", NULL};
+    PyArrayObject *input_array, *input, *labels = NULL;
+    int k, max_iter = 300, failed = 1;
+    double epsilon = 1e-4;
+    Matrix* data;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!i|id", kwlist, &PyArray_Type, &input_array, &k, &max_iter, &epsilon))
+        return NULL;
+    if (!convert_ndarray_to_matrix(input_array, &data, &input))
         return NULL;
+
+    npy_intp rows = data->rows;
+    if (k < 1 || k > data->rows || max_iter < 1)
+        PyErr_SetString(PyExc_ValueError, "k must be between 1 and the number of rows of X and max_iter positive.");
+    else if ((labels = (PyArrayObject*)PyArray_SimpleNew(1, &rows, NPY_INT32))) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = perform_kmeans(data, k, max_iter, epsilon, (int*)PyArray_DATA(labels));
+        Py_END_ALLOW_THREADS
+        if (failed) PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for k-means.");
     }
-    
-    /* Process the arrays */
-    double** result = perform_symnmf(c_array1, c_array2, rows, cols);
-    free_matrix(c_array1, rows); /* No need for it any more c_array2 was freed in perform symnmf*/
-    if (!result) {
-        PyErr_SetString(PyExc_RuntimeError, "perform_symnmf failed");
+    destroy_matrix(data);
+    Py_DECREF(input);
+    if (failed) {
+        Py_XDECREF(labels);
         return NULL;
     }
 
-    PyObject* packagedResult = packageArray(result, rows, cols);    /* Create NumPy array for output (double -> float64) */
-    
-    free_matrix(result, rows);
+    return (PyObject*)labels;
+}
 
-    return packagedResult;
-}
\ No newline at end of file
@@ -0,0 +1,410 @@
+/* Type-generic NumPy bridges of symnmfmodule.c. Not a standalone header: symnmfmodule.c includes it once per
+element type after defining REAL (the element type), MATRIX (the matching matrix type), NPY_REAL (its NumPy type
+number), REAL_NAME (its dtype name, for error messages) and FN(name) (the function name for the type, the same
+suffix symnmf.c gives its kernels), which are undefined again at the end.*/
+
+/* Function for viewing a 2D NumPy array as a matrix. REAL arrays whose rows are contiguous are borrowed as is
+(rows may be padded, the matrix stride follows them), anything else is converted once to a contiguous REAL copy.
+Params: np_arr - python nparray object, keep - receives the array holding the data (Py_DECREF it when done).
+Ret: NULL on failure (python error set).*/
+MATRIX* FN(borrow_matrix)(PyArrayObject* np_arr, PyArrayObject** keep) {
+    PyArrayObject* source = (PyArrayObject*)PyArray_FROM_OTF((PyObject*)np_arr, NPY_REAL, NPY_ARRAY_ALIGNED);
+    if (!source) return NULL;
+    int rows = (int) PyArray_DIM(source, 0); /* Get dims*/
+    int cols = (int) PyArray_DIM(source, 1);
+    npy_intp row_stride = PyArray_STRIDE(source, 0), col_stride = PyArray_STRIDE(source, 1);
+
+    if ((cols > 1 && col_stride != sizeof(REAL)) /* Columns matter whatever the row count, the row stride only past one*/
+        || (rows > 1 && (row_stride % sizeof(REAL) || row_stride < (npy_intp)(cols * sizeof(REAL))))) {
+        Py_SETREF(source, (PyArrayObject*)PyArray_FROM_OTF((PyObject*)source, NPY_REAL, NPY_ARRAY_IN_ARRAY)); /* The one copy*/
+        if (!source) return NULL;
+        row_stride = cols * sizeof(REAL);
+    }
+
+    MATRIX* matrix = FN(wrap_matrix)((REAL*)PyArray_DATA(source), rows, cols, rows > 1 ? (int)(row_stride / sizeof(REAL)) : cols);
+    if (!matrix) {
+        Py_DECREF(source);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    *keep = source;
+    return matrix;
+}
+
+/* Function for getting the result NumPy array up front so the kernels write straight into it: the caller's out= array
+(REAL, rows contiguous, writeable, right shape) or a new one. Params: out - out= argument or NULL/None, rows&cols - size,
+zeroed - whether to zero fill, result - receives a new reference to the array. Ret: matrix over it, NULL on failure.*/
+MATRIX* FN(output_matrix)(PyObject* out, int rows, int cols, int zeroed, PyArrayObject** result) {
+    npy_intp dims[2] = {rows, cols}; /*Init dimensions*/
+    PyArrayObject* output_array;
+    int stride = cols;
+
+    if (out && out != Py_None) {
+        output_array = (PyArrayObject*)out;
+        if (!PyArray_Check(out) || PyArray_NDIM(output_array) != 2 || PyArray_TYPE(output_array) != NPY_REAL
+            || !PyArray_ISALIGNED(output_array) || !PyArray_ISWRITEABLE(output_array)) {
+            PyErr_SetString(PyExc_TypeError, "out must be a writeable " REAL_NAME " 2D array.");
+            return NULL;
+        }
+        if (PyArray_DIM(output_array, 0) != rows || PyArray_DIM(output_array, 1) != cols) {
+            PyErr_SetString(PyExc_ValueError, "out has the wrong shape.");
+            return NULL;
+        }
+        npy_intp row_stride = PyArray_STRIDE(output_array, 0); /* Rows may be padded but each must be contiguous*/
+        if ((cols > 1 && PyArray_STRIDE(output_array, 1) != sizeof(REAL))
+            || (rows > 1 && (row_stride % sizeof(REAL) || row_stride < (npy_intp)(cols * sizeof(REAL))))) {
+            PyErr_SetString(PyExc_ValueError, "out rows must be contiguous.");
+            return NULL;
+        }
+        if (rows > 1) stride = (int)(row_stride / sizeof(REAL));
+        Py_INCREF(output_array);
+    } else {
+        output_array = (PyArrayObject*) (zeroed ? PyArray_ZEROS(2, dims, NPY_REAL, 0) : PyArray_SimpleNew(2, dims, NPY_REAL));
+        if (!output_array) return NULL;
+        zeroed = 0; /* Already zero*/
+    }
+
+    MATRIX* matrix = FN(wrap_matrix)((REAL*)PyArray_DATA(output_array), rows, cols, stride);
+    if (!matrix) {
+        Py_DECREF(output_array);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (int i = 0; zeroed && i < rows; i++)
+        memset(MAT_ROW(matrix, i), 0, cols * sizeof(REAL));
+    *result = output_array;
+    return matrix;
+}
+
+/* Function for checking and borrowing a NumPy array argument. Params: input_array - the array, out_data - result,
+keep - the array holding the data. Ret: 1 on success, 0 on failure (python error set).*/
+int FN(convert_ndarray_to_matrix)(PyArrayObject* input_array, MATRIX** out_data, PyArrayObject** keep) {
+    if (!is_real_matrix(input_array)) { /* Ensure it's a 2D real array */
+        PyErr_SetString(PyExc_TypeError, "Arguments incorrect type.");
+        return 0; /* 0 means error */
+    }
+
+    MATRIX* data = FN(borrow_matrix)(input_array, keep);
+    if (!data) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed in borrow_matrix.");
+        return 0; /* 0 means error */
+    }
+
+    *out_data = data;
+    return 1;  /* 1 means success */
+}
+
+/* The sym computation on a REAL matrix. Params: input_array - X, out - out= argument or NULL.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* FN(sym_bridge)(PyArrayObject* input_array, PyObject* out) {
+    MATRIX *data, *similarity;
+    PyArrayObject *input, *output = NULL;
+    int failed = 1;
+    if (!FN(convert_ndarray_to_matrix)(input_array, &data, &input))
+        return NULL;
+
+    similarity = FN(output_matrix)(out, data->rows, data->rows, 0, &output); /* Written in place, no extra copy*/
+    if (similarity && matrices_overlap(data, similarity))
+        PyErr_SetString(PyExc_ValueError, "out must not share memory with X.");
+    else if (similarity) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = FN(compute_similarity)(data, similarity, NULL, NULL);
+        Py_END_ALLOW_THREADS
+        if (failed) PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for similarity matrix.");
+    }
+    FN(destroy_matrix)(data); /* No need for it any more */
+    FN(destroy_matrix)(similarity);
+    Py_DECREF(input);
+    if (failed) {
+        Py_XDECREF(output);
+        return NULL;
+    }
+
+    return (PyObject*)output;
+}
+
+/* The ddg computation on a REAL matrix. Params: input_array - X, out - out= argument or NULL.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* FN(ddg_bridge)(PyArrayObject* input_array, PyObject* out) {
+    MATRIX *data, *degreeMatrix;
+    PyArrayObject *input, *output = NULL;
+    int failed;
+    if (!FN(convert_ndarray_to_matrix)(input_array, &data, &input))
+        return NULL;
+    int rows = data->rows;
+
+    REAL* dgg = (REAL*)malloc((rows ? rows : 1) * sizeof(REAL));
+    failed = !dgg;
+    if (dgg) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = FN(compute_similarity)(data, NULL, NULL, dgg); /* Row sums only, no n x n similarity*/
+        Py_END_ALLOW_THREADS
+    }
+    FN(destroy_matrix)(data); /* No need for it any more */
+    Py_DECREF(input);
+    if (failed) {
+        free(dgg);
+        PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for degree array.");
+        return NULL;
+    }
+
+    degreeMatrix = FN(output_matrix)(out, rows, rows, 1, &output); /* 0 off the diagonal*/
+    if (degreeMatrix) {
+        for (int i = 0; i < rows; i++)
+            MAT(degreeMatrix, i, i) = dgg[i];
+        FN(destroy_matrix)(degreeMatrix);
+    }
+    free(dgg); /* No need for it any more */
+
+    return degreeMatrix ? (PyObject*)output : NULL;
+}
+
+/* The dense norm computation on a REAL matrix. Params: input_array - X, out - out= argument or NULL.
+Ret : NULL on failure (Will raise a python error)*/
+static PyObject* FN(norm_bridge)(PyArrayObject* input_array, PyObject* out) {
+    PyArrayObject *input, *output = NULL;
+    int failed = 1;
+    MATRIX *data, *normsym;
+    if (!FN(convert_ndarray_to_matrix)(input_array, &data, &input))
+        return NULL;
+    int rows = data->rows;
+
+    normsym = FN(output_matrix)(out, rows, rows, 0, &output); /* The only n x n buffer, normalized in place*/
+    REAL* degrees = (REAL*)malloc((rows ? rows : 1) * sizeof(REAL));
+    if (normsym && matrices_overlap(data, normsym))
+        PyErr_SetString(PyExc_ValueError, "out must not share memory with X.");
+    else if (normsym && degrees) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = FN(compute_similarity)(data, normsym, NULL, degrees) /* degrees fused in*/
+            || FN(normalize_similarity)(normsym, NULL, degrees);
+        Py_END_ALLOW_THREADS
+    }
+    FN(destroy_matrix)(data); /* No need for it any more */
+    Py_DECREF(input);
+    FN(destroy_matrix)(normsym);
+    free(degrees);
+    if (failed) {
+        Py_XDECREF(output);
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_RuntimeError, "Memory allocation failed for normalized similarity matrix.");
+        return NULL;
+    }
+
+    return (PyObject*)output;
+}
+
+/* Function for the H argument of the SymNMF bridges: H is iterated in place in the result array, out= itself
+(out=H updates H) or a new array holding a copy of H. Params: array2 - H, out - out= argument or NULL, output -
+receives a new reference to the result array. Ret: matrix over the result array, NULL on failure (python error set).*/
+static MATRIX* FN(starting_H)(PyArrayObject* array2, PyObject* out, PyArrayObject** output) {
+    PyArrayObject* initial;
+    MATRIX *H, *H_init;
+    if (!FN(convert_ndarray_to_matrix)(array2, &H_init, &initial))
+        return NULL;
+
+    H = FN(output_matrix)(out, H_init->rows, H_init->cols, 0, output);
+    if (H && H->data != H_init->data && matrices_overlap(H, H_init)) {
+        PyErr_SetString(PyExc_ValueError, "out must be H itself or not share memory with it.");
+        FN(destroy_matrix)(H);
+        H = NULL;
+        Py_CLEAR(*output);
+    }
+    for (int i = 0; H && H->data != H_init->data && i < H->rows; i++) /* The one copy of the starting point*/
+        memcpy(MAT_ROW(H, i), MAT_ROW(H_init, i), H->cols * sizeof(REAL));
+    FN(destroy_matrix)(H_init);
+    Py_DECREF(initial);
+    return H;
+}
+
+/* The SymNMF iterations on a REAL H. Params: array1 - W (2D array or CSR tuple), array2 - H, out - out= argument
+or NULL, options - solver settings. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* FN(symnmf_bridge)(PyObject* array1, PyArrayObject* array2, PyObject* out, const SolverOptions* options) {
+    PyArrayObject *input = NULL, *output = NULL, *keep[3] = {NULL, NULL, NULL};
+    MATRIX *W = NULL, *result = NULL;
+    SparseMatrix* sparse_W = NULL;
+    MATRIX* H = FN(starting_H)(array2, out, &output);
+    if (!H)
+        return NULL;
+
+    if (PyTuple_Check(array1)) sparse_W = borrow_csr_tuple(array1, H->rows, keep);
+    else if (FN(convert_ndarray_to_matrix)((PyArrayObject*)array1, &W, &input)) {
+        if (W->rows != H->rows || W->cols != H->rows)
+            PyErr_SetString(PyExc_ValueError, "W must be n x n for an n x k H.");
+        else if (matrices_overlap(W, H))
+            PyErr_SetString(PyExc_ValueError, "out must not share memory with W.");
+    }
+
+    /* Process the arrays, H is updated in place */
+    if ((W || sparse_W) && !PyErr_Occurred()) {
+        Py_BEGIN_ALLOW_THREADS
+        result = sparse_W ? FN(perform_sparse_symnmf)(sparse_W, H, options) : FN(perform_symnmf)(W, H, options);
+        Py_END_ALLOW_THREADS
+        if (!result) PyErr_SetString(PyExc_RuntimeError, "perform_symnmf failed");
+    }
+    FN(destroy_matrix)(W); /* No need for it any more */
+    destroy_sparse_matrix(sparse_W);
+    FN(destroy_matrix)(H);
+    Py_XDECREF(input);
+    for (int i = 0; i < 3; i++) Py_XDECREF(keep[i]);
+    if (!result) {
+        Py_XDECREF(output);
+        return NULL;
+    }
+
+    return (PyObject*)output;
+}
+
+/* The SymNMF of a REAL X and H that never holds W in memory: out of core (W only exists in a scratch file) or
+matrix-free (W regenerated every iteration). Params: input_array - X, array2 - H, matrix_free - which of the two,
+scratch - scratch directory or NULL, out - out= argument or NULL, options - solver settings. Ret : NULL on failure (Will raise a python error)*/
+static PyObject* FN(data_symnmf_bridge)(PyArrayObject* input_array, PyArrayObject* array2, int matrix_free, const char* scratch,
+                                        PyObject* out, const SolverOptions* options) {
+    PyArrayObject *input, *output = NULL;
+    MATRIX *data, *result = NULL;
+    if (!FN(convert_ndarray_to_matrix)(input_array, &data, &input))
+        return NULL;
+    MATRIX* H = FN(starting_H)(array2, out, &output);
+
+    if (H && H->rows != data->rows)
+        PyErr_SetString(PyExc_ValueError, "H must have a row for every row of X.");
+    else if (H && matrices_overlap(data, H))
+        PyErr_SetString(PyExc_ValueError, "out must not share memory with X.");
+    else if (H) {
+        errno = 0;
+        Py_BEGIN_ALLOW_THREADS
+        result = matrix_free ? FN(perform_matrix_free_symnmf)(data, H, options)
+                             : FN(perform_out_of_core_symnmf)(data, H, scratch, options);
+        Py_END_ALLOW_THREADS
+        if (!result && errno && !matrix_free) PyErr_SetFromErrno(PyExc_OSError); /* Usually the scratch file*/
+        else if (!result) PyErr_SetString(PyExc_RuntimeError, "perform_symnmf failed");
+    }
+    FN(destroy_matrix)(data);
+    FN(destroy_matrix)(H);
+    Py_DECREF(input);
+    if (!result) {
+        Py_XDECREF(output);
+        return NULL;
+    }
+
+    return (PyObject*)output;
+}
+
+/* Multi-start SymNMF of a REAL W. Params: array1 - W (2D array or CSR tuple), k - columns of H, restarts - runs,
+seed - seed of the first run, options - solver settings. Ret : (H, stats) tuple, NULL on failure (Will raise a python error)*/
+static PyObject* FN(restarts_bridge)(PyObject* array1, int k, int restarts, unsigned long seed, const SolverOptions* options) {
+    PyArrayObject *input = NULL, *output = NULL, *keep[3] = {NULL, NULL, NULL};
+    MATRIX *W = NULL, *H = NULL, *result = NULL;
+    SparseMatrix* sparse_W = NULL;
+    PyObject* packaged = NULL;
+    RestartStats* stats = (RestartStats*)malloc(restarts * sizeof(RestartStats));
+    int n = 0;
+    if (!stats)
+        return PyErr_NoMemory();
+
+    if (PyTuple_Check(array1)) { /* n from indptr, which borrow_csr_tuple checks*/
+        if (PyTuple_Size(array1) == 3) n = (int)PyObject_Length(PyTuple_GET_ITEM(array1, 2)) - 1;
+        sparse_W = borrow_csr_tuple(array1, n, keep);
+    } else if (FN(convert_ndarray_to_matrix)((PyArrayObject*)array1, &W, &input)) {
+        n = W->rows;
+        if (W->cols != n) PyErr_SetString(PyExc_ValueError, "W must be n x n.");
+    }
+    if ((W || sparse_W) && !PyErr_Occurred()) {
+        if (k < 1 || k > n) PyErr_SetString(PyExc_ValueError, "k must be between 1 and the number of rows of W.");
+        else H = FN(output_matrix)(NULL, n, k, 0, &output);
+    }
+
+    if (H) {
+        Py_BEGIN_ALLOW_THREADS
+        result = sparse_W ? FN(perform_sparse_multi_start_symnmf)(sparse_W, H, restarts, seed, options, stats)
+                          : FN(perform_multi_start_symnmf)(W, H, restarts, seed, options, stats);
+        Py_END_ALLOW_THREADS
+        if (!result) PyErr_SetString(PyExc_RuntimeError, "perform_symnmf failed");
+    }
+    if (result) packaged = package_run_stats(stats, restarts);
+    if (packaged) { /* The run that was kept: the first of lowest objective*/
+        int best = 0;
+        for (int r = 1; r < restarts; r++)
+            if (stats[r].objective < stats[best].objective) best = r;
+        PyObject* index = PyLong_FromLong(best);
+        if (!index || PyDict_SetItemString(packaged, "best", index)) Py_CLEAR(packaged);
+        Py_XDECREF(index);
+    }
+    FN(destroy_matrix)(W);
+    destroy_sparse_matrix(sparse_W);
+    FN(destroy_matrix)(H);
+    Py_XDECREF(input);
+    for (int i = 0; i < 3; i++) Py_XDECREF(keep[i]);
+    free(stats);
+    if (!packaged) {
+        Py_XDECREF(output);
+        return NULL;
+    }
+
+    return Py_BuildValue("(NN)", output, packaged);
+}
+
+/* SymNMF of the REAL norm(X) for every k in k_min..k_max, W built once. Params: input_array - X, k_min&k_max - the
+range, warm_start - whether each k starts from the previous k's H, seed - seed of the initialize_H starts, options -
+solver settings. Ret : (list of H, stats) tuple, NULL on failure (Will raise a python error)*/
+static PyObject* FN(sweep_bridge)(PyArrayObject* input_array, int k_min, int k_max, int warm_start, unsigned long seed,
+                                  const SolverOptions* options) {
+    PyArrayObject* input;
+    PyObject *list = NULL, *packaged = NULL, *ks = NULL;
+    MATRIX *data, *W = NULL, **H = NULL;
+    RestartStats* stats = NULL;
+    REAL* degrees = NULL;
+    int count = k_max - k_min + 1, failed = 1, i = 0;
+    if (!FN(convert_ndarray_to_matrix)(input_array, &data, &input))
+        return NULL;
+    int n = data->rows;
+
+    if (k_min < 1 || k_max < k_min || k_max > n)
+        PyErr_SetString(PyExc_ValueError, "k_min and k_max must satisfy 1 <= k_min <= k_max <= number of rows of X.");
+    else {
+        W = FN(create_matrix)(n, n); /* The one n x n buffer*/
+        degrees = (REAL*)malloc(n * sizeof(REAL));
+        H = (MATRIX**)calloc(count, sizeof(MATRIX*));
+        stats = (RestartStats*)malloc(count * sizeof(RestartStats));
+        list = PyList_New(count);
+    }
+    for (i = 0; list && H && i < count; i++) { /* The kernels write straight into the returned arrays*/
+        PyArrayObject* array;
+        H[i] = FN(output_matrix)(NULL, n, k_min + i, 0, &array);
+        if (!H[i]) break;
+        PyList_SET_ITEM(list, i, (PyObject*)array);
+    }
+
+    if (list && i == count && W && degrees && stats) {
+        Py_BEGIN_ALLOW_THREADS
+        failed = FN(compute_similarity)(data, W, NULL, degrees) || FN(normalize_similarity)(W, NULL, degrees)
+            || FN(perform_symnmf_sweep)(W, H, k_min, k_max, warm_start, seed, options, stats);
+        Py_END_ALLOW_THREADS
+        if (failed) PyErr_SetString(PyExc_RuntimeError, "perform_symnmf failed");
+    } else if (!PyErr_Occurred())
+        PyErr_NoMemory();
+    if (!failed) packaged = package_run_stats(stats, count);
+    if (packaged) {
+        ks = PyArray_Arange(k_min, k_max + 1, 1, NPY_INT32);
+        if (!ks || PyDict_SetItemString(packaged, "k", ks)) Py_CLEAR(packaged);
+        Py_XDECREF(ks);
+    }
+    for (i = 0; H && i < count; i++)
+        FN(destroy_matrix)(H[i]);
+    free(H);
+    free(stats);
+    free(degrees);
+    FN(destroy_matrix)(W);
+    FN(destroy_matrix)(data);
+    Py_DECREF(input);
+    if (!packaged) {
+        Py_XDECREF(list);
+        return NULL;
+    }
+
+    return Py_BuildValue("(NN)", list, packaged);
+}
+
+#undef REAL
+#undef MATRIX
+#undef NPY_REAL
+#undef REAL_NAME
+#undef FN
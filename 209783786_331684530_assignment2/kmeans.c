@@ -1,105 +1,223 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
-#include <Python.h>
+#include <float.h>
+#include "kmeans.h"
+#ifdef _OPENMP
+#include <omp.h>
+#define THREAD_COUNT() omp_get_max_threads()
+#define THREAD_ID() omp_get_thread_num()
+#else
+#define THREAD_COUNT() 1
+#define THREAD_ID() 0
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KMEANS_X86 1
+#endif
 
+void print_data(const Matrix *data);
 
-double getDistance(double a[],double b[],int dim);
-void print_data(double **data, int rows, int cols);
+/* Per point distance bounds of the accelerated (Hamerly) mode. upper[i] bounds the distance from
+vector i to its centroid assigned[i] from above, lower[i] the distance to every other centroid
+from below; halfGap[j] is half the distance from centroid j to its nearest other centroid and
+shift[j] how far centroid j moved in the last update. Every bound is widened by the relative
+slack of the element type's distances. */
+typedef struct {
+    int* assigned;
+    double* upper;
+    double* lower;
+    double* halfGap;
+    double* shift;
+    double slack;
+} Bounds;
 
-double getDistance(double a[], double b[], int dim) {
-    double sum = 0, diff;
-    int i;
-    for (i = 0; i < dim; i++) {
-        diff = a[i] - b[i];
-        sum += diff * diff;
+/* Allocate the bounds for n vectors and k centroids with the given slack. NULL on failure. */
+static Bounds* create_bounds(int n, int k, double slack) {
+    Bounds* bounds = calloc(1, sizeof(Bounds));
+    if (!bounds) return NULL;
+    bounds->slack = slack;
+    bounds->assigned = malloc((n ? n : 1) * sizeof(int));
+    bounds->upper = malloc((n ? n : 1) * sizeof(double));
+    bounds->lower = malloc((n ? n : 1) * sizeof(double));
+    bounds->halfGap = malloc(k * sizeof(double));
+    bounds->shift = malloc(k * sizeof(double));
+    if (!bounds->assigned || !bounds->upper || !bounds->lower || !bounds->halfGap || !bounds->shift) {
+        free(bounds->assigned);
+        free(bounds->upper);
+        free(bounds->lower);
+        free(bounds->halfGap);
+        free(bounds->shift);
+        free(bounds);
+        return NULL;
     }
-    return sqrt(sum);
+    return bounds;
 }
 
-void print_data(double **data, int rows, int cols) {
-    int i, j;
-    for (i = 0; i < rows; i++)
-    {
-        for (j = 0; j < cols; j++) {
-            printf("%.4f", data[i][j]);
-                if (j < cols - 1) printf(",");
-        }
-        printf("\n");
-    }
+static void destroy_bounds(Bounds* bounds) {
+    if (!bounds) return;
+    free(bounds->assigned);
+    free(bounds->upper);
+    free(bounds->lower);
+    free(bounds->halfGap);
+    free(bounds->shift);
+    free(bounds);
 }
 
+/* Loosen the bounds by how far the centroids moved: a vector's own centroid got at most
+shift[assigned] further away, any other one at most the largest other shift closer. */
+static void move_bounds(Bounds* bounds, int vector_count, int k) {
+    int i, j, first = 0, second = -1;
+    for (j = 1; j < k; j++) { /* The two largest shifts*/
+        if (bounds->shift[j] > bounds->shift[first]) {
+            second = first;
+            first = j;
+        } else if (second < 0 || bounds->shift[j] > bounds->shift[second])
+            second = j;
+    }
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < vector_count; i++) {
+        int a = bounds->assigned[i];
+        double others = a == first ? (second < 0 ? 0 : bounds->shift[second]) : bounds->shift[first];
+        bounds->upper[i] = (bounds->upper[i] + bounds->shift[a]) * (1 + bounds->slack);
+        bounds->lower[i] = (bounds->lower[i] - others) * (1 - bounds->slack);
+    }
+}
 
-PyObject* kmeans_c(double **vectors, double **clusters, int k, int maxIter, double eps, int dim, int vector_count) {
-    // print_data(vectors, vector_count, dim);
-    // printf("\n\n");
-    // print_data(clusters, k, dim);
-    // printf("\n\n");
-
-    
-    int *clusterSizes; 
-    double **sums, **prevClusters;
-    int i, j, iter, converged = 0;
+/* The Lloyd kernels, instantiated once per element type from kmeans_kernels.h */
+#define REAL double
+#define MATRIX Matrix
+#define FN(name) name
+#define VEC256 __m256d
+#define VEC256_OP(op) _mm256_##op##_pd
+#define VEC512 __m512d
+#define VEC512_OP(op) _mm512_##op##_pd
+#include "kmeans_kernels.h"
 
-//print epsilon
+#define REAL float
+#define MATRIX FloatMatrix
+#define FN(name) name##_f
+#define VEC256 __m256
+#define VEC256_OP(op) _mm256_##op##_ps
+#define VEC512 __m512
+#define VEC512_OP(op) _mm512_##op##_ps
+#include "kmeans_kernels.h"
 
-    printf("c kmeans %lf",eps);
+/* Compatibility shim: rows point into one contiguous aligned block. NULL on failure. */
+double** allocate_matrix(int rows, int cols) {
+    int i;
+    Matrix* block = create_matrix(rows, cols);
+    double** matrix;
 
-    /* Create previous clusters 2d array - k x dim */
-    prevClusters = malloc(k * sizeof(double *));
-    for (i = 0; i < k; i++) {
-        prevClusters[i] = malloc(dim * sizeof(double));
+    if (!block) return NULL;
+    matrix = malloc((rows ? rows : 1) * sizeof(double *));
+    if (!matrix) {
+        destroy_matrix(block);
+        return NULL;
     }
+    matrix[0] = block->data;
+    for (i = 1; i < rows; i++)
+        matrix[i] = MAT_ROW(block, i);
+    block->owner = 0; /* The block is now owned through matrix[0] */
+    destroy_matrix(block);
+    return matrix;
+}
 
-    /* Initiliaze sums 2d array - k x dim
-       and clusterSize 1d array - k */
-    sums = malloc(k * sizeof(double *));
-    for (i = 0; i < k; i++) {
-        sums[i] = malloc(dim * sizeof(double));
-    }
-    clusterSizes = calloc(k, sizeof(int));
+/* Free a matrix made by allocate_matrix. */
+void free_matrix(double** matrix) {
+    if (!matrix) return;
+    free(matrix[0]);
+    free(matrix);
+}
 
-    
-    for (iter = 0; iter < maxIter && !converged; iter++) {
-        /* Reset sums and sizes*/
-        for (i = 0; i < k; i++) {
-            for (j = 0; j < dim; j++) {
-                sums[i][j] = 0;
-            }
-            clusterSizes[i] = 0;
+void print_data(const Matrix *data) {
+    int i, j;
+    for (i = 0; i < data->rows; i++)
+    {
+        for (j = 0; j < data->cols; j++) {
+            printf("%.4f", MAT(data, i, j));
+                if (j < data->cols - 1) printf(",");
         }
+        printf("\n");
+    }
+}
 
-        /*Assign vectors to clusters*/
-        for (i = 0; i < vector_count; i++) {
-            int minCluster = 0;
-            double minDist = getDistance(vectors[i], clusters[0], dim);
 
-            for (j = 1; j < k; j++) {
-                double dist = getDistance(vectors[i], clusters[j], dim);
-                if (dist < minDist) {
-                    minDist = dist;
-                    minCluster = j;
-                }
-            }
+/* Scratch space of the mini-batch engine, reused across batches. */
+struct MiniBatch {
+    Matrix* centers;   /* Transposed, padded centroid block */
+    Matrix* distances; /* One row of distances per thread */
+    int* labels;       /* Nearest centroid of every row of the current batch */
+    int capacity;      /* Rows handled per pass */
+    DistanceKernel distances_to;
+};
 
-            clusterSizes[minCluster]++;
-            for (j = 0; j < dim; j++) {
-                sums[minCluster][j] += vectors[i][j];
-            }
-        }
+/* Allocate the mini-batch scratch for k centroids of dimension dim, batches of up to batch_size
+rows per pass (larger batches are taken in several passes). NULL on failure. */
+MiniBatch* create_minibatch(int k, int dim, int batch_size) {
+    int padded = (k + CENTROID_LANES - 1) / CENTROID_LANES * CENTROID_LANES;
+    MiniBatch* state = calloc(1, sizeof(MiniBatch));
+    if (!state) return NULL;
+    state->capacity = batch_size > 0 ? batch_size : 1;
+    state->centers = create_matrix(dim, padded);
+    state->distances = create_matrix(THREAD_COUNT(), padded);
+    state->labels = malloc(state->capacity * sizeof(int));
+    state->distances_to = select_distance_kernel();
+    if (!state->centers || !state->distances || !state->labels) {
+        destroy_minibatch(state);
+        return NULL;
+    }
+    memset(state->centers->data, 0, (size_t)dim * padded * sizeof(double)); /* Padding lanes stay zero */
+    return state;
+}
 
-        converged = 1;
-        /* Update clusters*/
-        for (i = 0; i < k; i++) {
-            for (j = 0; j < dim; j++) {
-                prevClusters[i][j] = clusters[i][j];
-                clusters[i][j] = clusterSizes[i] ? sums[i][j] / clusterSizes[i] : clusters[i][j];
-            }
+void destroy_minibatch(MiniBatch* state) {
+    if (!state) return;
+    destroy_matrix(state->centers);
+    destroy_matrix(state->distances);
+    free(state->labels);
+    free(state);
+}
+
+/* Fold one batch into the centroids (Sculley's mini-batch k-means). The batch rows are assigned
+to their nearest centroid in parallel, then each centroid moves towards its rows in batch order
+with step 1 / counts[c], so every centroid stays the running mean of the rows it absorbed (and
+its starting position). Params: state - scratch, centroids - k x dim, updated in place, counts -
+rows absorbed per centroid, updated in place, batch - rows x dim. Ret: None. */
+void minibatch_update(MiniBatch* state, Matrix* centroids, double* counts, const Matrix* batch) {
+    int first, i, j, k = centroids->rows, dim = centroids->cols;
 
-            if (getDistance(clusters[i], prevClusters[i], dim) > eps)
-                converged = 0;
+    for (first = 0; first < batch->rows; first += state->capacity) {
+        int rows = batch->rows - first < state->capacity ? batch->rows - first : state->capacity;
+        transpose_centroids(centroids, state->centers);
+#pragma omp parallel private(i)
+        {
+            double* dist = MAT_ROW(state->distances, THREAD_ID());
+#pragma omp for schedule(static)
+            for (i = 0; i < rows; i++)
+                state->labels[i] = nearest_centroid(state->distances_to, MAT_ROW(batch, first + i), state->centers, k, dist);
+        }
+        for (i = 0; i < rows; i++) {
+            const double* vector = MAT_ROW(batch, first + i);
+            double* centroid = MAT_ROW(centroids, state->labels[i]);
+            double step = 1 / ++counts[state->labels[i]];
+            for (j = 0; j < dim; j++)
+                centroid[j] += step * (vector[j] - centroid[j]);
         }
     }
+}
+
+
+/* kmeans_lloyd returning the final centroids as a Python list of lists. NULL (python error set)
+on failure. */
+PyObject* kmeans_c(const Matrix *vectors, Matrix *clusters, int maxIter, double eps, int accelerated) {
+    int i, j, k = clusters->rows, dim = clusters->cols;
+
+    if (kmeans_lloyd(vectors, clusters, maxIter, eps, accelerated, NULL, NULL))
+        return PyErr_NoMemory();
 
     /* Create return Python List */
     PyObject* py_list = PyList_New(k);
@@ -112,30 +230,300 @@ PyObject* kmeans_c(double **vectors, double **clusters, int k, int maxIter, doub
         PyObject* vector = PyList_New(dim);
         if (!vector) {
             Py_DECREF(py_list);  /* Clean up the outer list on failure */
-            return NULL;
+            py_list = NULL;
+            break;
         }
         for (j = 0; j < dim; j++) {
-            PyList_SetItem(vector, j, PyFloat_FromDouble(clusters[i][j]));
+            PyList_SetItem(vector, j, PyFloat_FromDouble(MAT(clusters, i, j)));
         }
         
         PyList_SetItem(py_list, i, vector);
     }
 
+    return py_list; /* Return the Python list */
+}
+
+/* MT19937 seeded and drawn exactly like NumPy's legacy np.random (np.random.seed(int)), so a seed
+reproduces the choices of the former Python seeding loop. */
+void mt_seed(MersenneTwister* mt, uint32_t seed) {
+    int i;
+    mt->state[0] = seed;
+    for (i = 1; i < MT_STATE_SIZE; i++)
+        mt->state[i] = 1812433253U * (mt->state[i - 1] ^ (mt->state[i - 1] >> 30)) + (uint32_t)i;
+    mt->index = MT_STATE_SIZE;
+}
 
-    /* Print final clusters*/
-    // print_data(clusters, k, dim);
-    
+uint32_t mt_next(MersenneTwister* mt) {
+    uint32_t y;
+    if (mt->index >= MT_STATE_SIZE) { /* Regenerate the whole state */
+        int i;
+        for (i = 0; i < MT_STATE_SIZE; i++) {
+            y = (mt->state[i] & 0x80000000U) | (mt->state[(i + 1) % MT_STATE_SIZE] & 0x7fffffffU);
+            mt->state[i] = mt->state[(i + 397) % MT_STATE_SIZE] ^ (y >> 1) ^ ((y & 1) ? 0x9908b0dfU : 0);
+        }
+        mt->index = 0;
+    }
+    y = mt->state[mt->index++];
+    y ^= y >> 11;
+    y ^= (y << 7) & 0x9d2c5680U;
+    y ^= (y << 15) & 0xefc60000U;
+    return y ^ (y >> 18);
+}
 
+/* np.random.random_sample(): uniform in [0, 1) with 53 random bits. */
+double mt_random_sample(MersenneTwister* mt) {
+    uint32_t a = mt_next(mt) >> 5, b = mt_next(mt) >> 6;
+    return (a * 67108864.0 + b) / 9007199254740992.0;
+}
 
+/* np.random.randint(0, high) for 0 < high <= 2^32: masked rejection sampling. */
+uint32_t mt_randint(MersenneTwister* mt, uint32_t high) {
+    uint32_t range = high - 1, mask = range, value;
+    if (range == 0) return 0;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+    while ((value = mt_next(mt) & mask) > range);
+    return value;
+}
 
-    /* Free memory*/
-    for (i = 0; i < k; i++) {
-        free(sums[i]);
-        free(prevClusters[i]);
+/* Sum as NumPy's np.sum does for float64 (pairwise, 8 accumulators per block), so sampling
+probabilities match the Python code's weights / weights.sum() bit for bit. */
+static double pairwise_sum(const double* a, size_t n) {
+    size_t i;
+    if (n < 8) {
+        double sum = 0;
+        for (i = 0; i < n; i++)
+            sum += a[i];
+        return sum;
     }
-    free(sums);
-    free(prevClusters);
-    free(clusterSizes);
+    if (n <= 128) {
+        double r[8], sum;
+        int j;
+        for (j = 0; j < 8; j++)
+            r[j] = a[j];
+        for (i = 8; i < n - n % 8; i += 8)
+            for (j = 0; j < 8; j++)
+                r[j] += a[i + j];
+        sum = ((r[0] + r[1]) + (r[2] + r[3])) + ((r[4] + r[5]) + (r[6] + r[7]));
+        for (; i < n; i++)
+            sum += a[i];
+        return sum;
+    } else {
+        size_t half = n / 2;
+        half -= half % 8;
+        return pairwise_sum(a, half) + pairwise_sum(a + half, n - half);
+    }
+}
 
-    return py_list; /* Return the Python list */
-}
\ No newline at end of file
+/* Seeding state: the data, the running distance of every vector to its nearest chosen centroid
+and the scratch for np.random.choice(n, p=weights/weights.sum()). */
+typedef struct {
+    const Matrix* vectors;
+    double* weights;
+    double* cdf;
+    MersenneTwister mt;
+} Seeding;
+
+static double vector_distance(const Matrix* vectors, int a, int b) {
+    return sqrt(squaredDistance(MAT_ROW(vectors, a), MAT_ROW(vectors, b), vectors->cols));
+}
+
+/* Build the sampling distribution of weights[0..n) the way np.random.choice does (normalize,
+cumsum, divide by the last entry). Ret: 0, or 1 if all weights are zero. */
+static int prepare_choice(Seeding* seeding, const double* weights, int n) {
+    double total = pairwise_sum(weights, (size_t)n), running = 0, last;
+    int i;
+    if (!(total > 0)) return 1;
+    for (i = 0; i < n; i++) {
+        running += weights[i] / total;
+        seeding->cdf[i] = running;
+    }
+    last = seeding->cdf[n - 1];
+    for (i = 0; i < n; i++)
+        seeding->cdf[i] /= last;
+    return 0;
+}
+
+/* One draw from the prepared distribution: the first index whose cdf exceeds a uniform sample. */
+static int draw_choice(Seeding* seeding, int n) {
+    double u = mt_random_sample(&seeding->mt);
+    int low = 0, high = n;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (seeding->cdf[middle] > u) high = middle;
+        else low = middle + 1;
+    }
+    return low < n ? low : n - 1;
+}
+
+/* Lower the running distances by a newly chosen centroid (in parallel over the vectors). */
+static void add_centroid(Seeding* seeding, int chosen) {
+    int i, n = seeding->vectors->rows;
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < n; i++) {
+        if (seeding->weights[i] != 0) {
+            double dist = vector_distance(seeding->vectors, i, chosen);
+            if (dist < seeding->weights[i]) seeding->weights[i] = dist;
+        }
+    }
+    seeding->weights[chosen] = 0;
+}
+
+/* Sum of the running distances were candidate chosen too (the greedy variant's score). */
+static double potential_with(const Seeding* seeding, int candidate) {
+    int i, n = seeding->vectors->rows;
+    double potential = 0;
+#pragma omp parallel for reduction(+:potential) schedule(static)
+    for (i = 0; i < n; i++) {
+        double weight = seeding->weights[i];
+        if (weight != 0) {
+            double dist = vector_distance(seeding->vectors, i, candidate);
+            potential += dist < weight ? dist : weight;
+        }
+    }
+    return potential;
+}
+
+/* k-means|| (Bahmani et al.): rounds passes that each keep every vector with probability
+oversampling * weight / total, then a weighted k-means++ over the kept candidates, each weighted by
+the number of vectors nearest to it. Falls back to plain draws if too few candidates are kept.
+Ret: 0 on success, 1 on allocation failure, 2 if the data has fewer than k distinct vectors. */
+static int seed_parallel(Seeding* seeding, int k, double oversampling, int rounds, int* indices) {
+    int i, c, round, count = 1, n = seeding->vectors->rows, status = 0;
+    int* candidates = malloc((size_t)n * sizeof(int));
+    int* nearest = malloc((size_t)n * sizeof(int));
+    double* candidateWeights = NULL;
+    double* candidateDistances = NULL;
+
+    if (!candidates || !nearest) {
+        free(candidates);
+        free(nearest);
+        return 1;
+    }
+    candidates[0] = indices[0];
+    for (round = 0; round < rounds; round++) {
+        double total = pairwise_sum(seeding->weights, (size_t)n);
+        int first = count;
+        if (!(total > 0)) break;
+        for (i = 0; i < n; i++) { /* Serial so the draws follow the vector order */
+            double u = mt_random_sample(&seeding->mt);
+            if (seeding->weights[i] != 0 && u < oversampling * seeding->weights[i] / total)
+                candidates[count++] = i;
+        }
+        for (c = first; c < count; c++)
+            add_centroid(seeding, candidates[c]);
+    }
+    while (count < k) { /* Too few candidates: complete with plain k-means++ draws */
+        if (prepare_choice(seeding, seeding->weights, n)) {
+            status = 2;
+            break;
+        }
+        candidates[count] = draw_choice(seeding, n);
+        add_centroid(seeding, candidates[count++]);
+    }
+    if (!status && count == k) memcpy(indices, candidates, (size_t)k * sizeof(int));
+    else if (!status) {
+        candidateWeights = calloc(count, sizeof(double));
+        candidateDistances = malloc((size_t)count * sizeof(double));
+        if (!candidateWeights || !candidateDistances) status = 1;
+    }
+    if (!status && count > k) {
+#pragma omp parallel for private(c) schedule(static)
+        for (i = 0; i < n; i++) { /* Weight each candidate by the vectors it is nearest to */
+            double best = HUGE_VAL;
+            for (c = 0; c < count; c++) {
+                double dist = squaredDistance(MAT_ROW(seeding->vectors, i), MAT_ROW(seeding->vectors, candidates[c]), seeding->vectors->cols);
+                if (dist < best) {
+                    best = dist;
+                    nearest[i] = c;
+                }
+            }
+        }
+        for (i = 0; i < n; i++)
+            candidateWeights[nearest[i]] += 1;
+        for (c = 0; c < count; c++)
+            candidateDistances[c] = HUGE_VAL;
+
+        for (i = 0; i < k && !status; i++) { /* Weighted k-means++ over the candidates */
+            int chosen;
+            for (c = 0; c < count; c++)
+                seeding->weights[c] = candidateWeights[c] * (i ? candidateDistances[c] : 1);
+            if (prepare_choice(seeding, seeding->weights, count)) {
+                status = 2;
+                break;
+            }
+            chosen = draw_choice(seeding, count);
+            indices[i] = candidates[chosen];
+            for (c = 0; c < count; c++) {
+                double dist = vector_distance(seeding->vectors, candidates[c], candidates[chosen]);
+                if (dist < candidateDistances[c]) candidateDistances[c] = dist;
+            }
+            candidateDistances[chosen] = 0;
+        }
+    }
+    free(candidates);
+    free(nearest);
+    free(candidateWeights);
+    free(candidateDistances);
+    return status;
+}
+
+/* k-means++ seeding. Each new centroid is drawn with probability proportional to the distance
+of a vector to its nearest centroid so far; the running distances make that O(N*k) in total.
+The first centroid is np.random.randint(N) and each next one np.random.choice(N, p), drawn from an
+MT19937 seeded like np.random.seed(seed), so SEEDING_STANDARD picks the same indices as the
+Python loop it replaces. SEEDING_GREEDY draws trials candidates per step (0: 2 + log k) and keeps
+the one lowering the total distance most; SEEDING_PARALLEL is k-means|| with the given
+oversampling (0: 2k) and rounds. Params: vectors - n x dim data, k - count, indices - receives the
+k chosen rows. Ret: 0 on success, 1 on allocation failure, 2 if fewer than k distinct vectors. */
+int kmeans_pp_init(const Matrix* vectors, int k, uint32_t seed, int method, int trials, double oversampling, int rounds, int* indices) {
+    Seeding seeding;
+    int i, t, n = vectors->rows, status = 0;
+
+    if (k < 1 || k > n) return 2;
+    seeding.vectors = vectors;
+    seeding.weights = malloc((size_t)n * sizeof(double));
+    seeding.cdf = malloc((size_t)n * sizeof(double));
+    if (!seeding.weights || !seeding.cdf) {
+        free(seeding.weights);
+        free(seeding.cdf);
+        return 1;
+    }
+    mt_seed(&seeding.mt, seed);
+    if (trials <= 0) trials = 2 + (int)log(k);
+    if (oversampling <= 0) oversampling = 2.0 * k;
+
+    for (i = 0; i < n; i++)
+        seeding.weights[i] = HUGE_VAL;
+    indices[0] = (int)mt_randint(&seeding.mt, (uint32_t)n);
+    add_centroid(&seeding, indices[0]);
+
+    if (method == SEEDING_PARALLEL) status = seed_parallel(&seeding, k, oversampling, rounds, indices);
+    else {
+        for (i = 1; i < k && !status; i++) {
+            if (prepare_choice(&seeding, seeding.weights, n)) {
+                status = 2;
+                break;
+            }
+            indices[i] = draw_choice(&seeding, n);
+            if (method == SEEDING_GREEDY) {
+                double best = potential_with(&seeding, indices[i]);
+                for (t = 1; t < trials; t++) {
+                    int candidate = draw_choice(&seeding, n);
+                    double potential = potential_with(&seeding, candidate);
+                    if (potential < best) {
+                        best = potential;
+                        indices[i] = candidate;
+                    }
+                }
+            }
+            add_centroid(&seeding, indices[i]);
+        }
+    }
+    free(seeding.weights);
+    free(seeding.cdf);
+    return status;
+}
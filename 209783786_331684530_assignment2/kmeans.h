@@ -1,8 +1,75 @@
-#include <stdlib.h>
-#include "kmeans.c"
 #ifndef KMEANS_H
 #define KMEANS_H
 
-PyObject* kmeans_c(double **vectors, double **clusters, int  k, int maxIter, double eps, int dim, int vector_count);
+#include <stddef.h>
+#include <stdint.h>
+#include <Python.h>
 
-#endif
\ No newline at end of file
+#define MATRIX_ALIGNMENT 64 /* Byte alignment of matrix storage (one cache line) */
+#define CENTROID_LANES 8 /* Centroid block padding: one AVX-512 register of doubles (twice as many floats) */
+#define HAMERLY_SLACK 1e-10 /* Least relative widening of the accelerated mode's bounds, grown per type and dim */
+#define DEFAULT_BATCH_SIZE 4096 /* Rows per mini-batch when the caller does not choose */
+
+/* Dense row-major matrix kept in one aligned allocation. Element (i,j) lives at
+data[i*stride + j], stride (leading dimension) >= cols. owner marks storage we must free. */
+typedef struct {
+    double* data;
+    int rows;
+    int cols;
+    int stride;
+    int owner;
+} Matrix;
+
+/* The same matrix over float elements, for the single precision kernels (the _f functions). */
+typedef struct {
+    float* data;
+    int rows;
+    int cols;
+    int stride;
+    int owner;
+} FloatMatrix;
+
+#define MAT_ROW(m, i) ((m)->data + (size_t)(i) * (m)->stride)
+#define MAT(m, i, j) (MAT_ROW(m, i)[j])
+
+Matrix* create_matrix(int rows, int cols);
+Matrix* wrap_matrix(double* data, int rows, int cols, int stride);
+void destroy_matrix(Matrix* matrix);
+FloatMatrix* create_matrix_f(int rows, int cols);
+FloatMatrix* wrap_matrix_f(float* data, int rows, int cols, int stride);
+void destroy_matrix_f(FloatMatrix* matrix);
+
+/* Compatibility shim: double** rows backed by a single contiguous block */
+double** allocate_matrix(int rows, int cols);
+void free_matrix(double** matrix);
+
+int kmeans_lloyd(const Matrix* vectors, Matrix* clusters, int maxIter, double eps, int accelerated, int* labels, double* inertia);
+int kmeans_lloyd_f(const FloatMatrix* vectors, FloatMatrix* clusters, int maxIter, double eps, int accelerated, int* labels, double* inertia);
+PyObject* kmeans_c(const Matrix* vectors, Matrix* clusters, int maxIter, double eps, int accelerated);
+
+/* MT19937 with NumPy's legacy seeding and draws (np.random.seed / randint / random_sample) */
+#define MT_STATE_SIZE 624
+typedef struct {
+    uint32_t state[MT_STATE_SIZE];
+    int index;
+} MersenneTwister;
+
+void mt_seed(MersenneTwister* mt, uint32_t seed);
+uint32_t mt_next(MersenneTwister* mt);
+double mt_random_sample(MersenneTwister* mt);
+uint32_t mt_randint(MersenneTwister* mt, uint32_t high);
+
+/* k-means++ seeding variants of kmeans_pp_init */
+#define SEEDING_STANDARD 0 /* D-weighted draws, the same choices as kmeans_pp.py used to make */
+#define SEEDING_GREEDY 1   /* Several candidates per step, keep the best */
+#define SEEDING_PARALLEL 2 /* k-means|| oversampling rounds, then a weighted k-means++ */
+#define DEFAULT_SEEDING_ROUNDS 5
+int kmeans_pp_init(const Matrix* vectors, int k, uint32_t seed, int method, int trials, double oversampling, int rounds, int* indices);
+
+/* Mini-batch (streaming) k-means: the data is fed a batch at a time and never held whole */
+typedef struct MiniBatch MiniBatch;
+MiniBatch* create_minibatch(int k, int dim, int batch_size);
+void destroy_minibatch(MiniBatch* state);
+void minibatch_update(MiniBatch* state, Matrix* centroids, double* counts, const Matrix* batch);
+
+#endif
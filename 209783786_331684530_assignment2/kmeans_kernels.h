@@ -0,0 +1,316 @@
+/* Type-generic Lloyd kernels of kmeans.c. Not a standalone header: kmeans.c includes it once per element
+type after defining REAL (the element type), MATRIX (the matching matrix type), FN(name) (the name for the
+type), VEC256/VEC512 (the AVX2/AVX-512 vector types of REAL) and VEC256_OP/VEC512_OP(op) (their intrinsics),
+which are undefined again at the end. Bounds, coordinate sums and the inertia stay in double. */
+
+/* Centroids per distance kernel lane block: one AVX-512 register of REAL */
+#define REAL_LANES (CENTROID_LANES * (int)(sizeof(double) / sizeof(REAL)))
+
+/* Relative slack of the accelerated mode's bounds: a REAL squared distance over dim coordinates is off by about
+(dim + 2) rounding errors of REAL, so float needs far more than HAMERLY_SLACK, its floor for double */
+#define REAL_EPSILON (sizeof(REAL) == sizeof(float) ? FLT_EPSILON : DBL_EPSILON)
+#define REAL_SLACK(dim) (HAMERLY_SLACK + 4.0 * ((dim) + 2) * REAL_EPSILON)
+
+/* Squared distances from one vector to every centroid of a transposed, padded centroid block:
+centers[d * padded + c] is coordinate d of centroid c, padded is a multiple of REAL_LANES. */
+typedef void (*FN(DistanceKernel))(const REAL* vector, const REAL* centers, int dim, int padded, REAL* out);
+
+/* Allocate a contiguous, MATRIX_ALIGNMENT aligned row-major matrix (stride == cols). NULL on failure. */
+MATRIX* FN(create_matrix)(int rows, int cols) {
+    MATRIX* matrix;
+    void* data = NULL;
+    size_t bytes = (size_t)rows * cols * sizeof(REAL);
+
+    if (rows < 0 || cols < 0) return NULL;
+    if (posix_memalign(&data, MATRIX_ALIGNMENT, bytes ? bytes : sizeof(REAL)))
+        return NULL;
+    matrix = FN(wrap_matrix)((REAL*)data, rows, cols, cols);
+    if (!matrix) {
+        free(data);
+        return NULL;
+    }
+    matrix->owner = 1;
+    return matrix;
+}
+
+/* Describe existing storage as a matrix without copying (storage is not freed with it). NULL on failure. */
+MATRIX* FN(wrap_matrix)(REAL* data, int rows, int cols, int stride) {
+    MATRIX* matrix = malloc(sizeof(MATRIX));
+    if (!matrix) return NULL;
+    matrix->data = data;
+    matrix->rows = rows;
+    matrix->cols = cols;
+    matrix->stride = stride;
+    matrix->owner = 0;
+    return matrix;
+}
+
+/* Free a matrix (and its storage if it owns it). */
+void FN(destroy_matrix)(MATRIX* matrix) {
+    if (!matrix) return;
+    if (matrix->owner)
+        free(matrix->data);
+    free(matrix);
+}
+
+/* Squared Euclidean distance; nearest-centroid search and the convergence test only compare
+distances, so the sqrt is never needed. */
+REAL FN(squaredDistance)(const REAL a[], const REAL b[], int dim) {
+    REAL sum = 0, diff;
+    int i;
+    for (i = 0; i < dim; i++) {
+        diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/* The kernels all add the squared differences in coordinate order, one centroid per lane, so
+they produce exactly the same sums as squaredDistance (setup.py turns off FMA contraction). */
+static void FN(distances_scalar)(const REAL* vector, const REAL* centers, int dim, int padded, REAL* out) {
+    int c, d;
+    for (c = 0; c < padded; c++)
+        out[c] = 0;
+    for (d = 0; d < dim; d++) {
+        const REAL x = vector[d], *row = centers + (size_t)d * padded;
+        for (c = 0; c < padded; c++) {
+            REAL diff = row[c] - x;
+            out[c] += diff * diff;
+        }
+    }
+}
+
+#ifdef KMEANS_X86
+__attribute__((target("avx2")))
+static void FN(distances_avx2)(const REAL* vector, const REAL* centers, int dim, int padded, REAL* out) {
+    int c, d;
+    for (c = 0; c < padded; c += 32 / (int)sizeof(REAL)) {
+        VEC256 sum = VEC256_OP(setzero)();
+        for (d = 0; d < dim; d++) {
+            VEC256 diff = VEC256_OP(sub)(VEC256_OP(load)(centers + (size_t)d * padded + c), VEC256_OP(set1)(vector[d]));
+            sum = VEC256_OP(add)(sum, VEC256_OP(mul)(diff, diff));
+        }
+        VEC256_OP(store)(out + c, sum);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void FN(distances_avx512)(const REAL* vector, const REAL* centers, int dim, int padded, REAL* out) {
+    int c, d;
+    for (c = 0; c < padded; c += 64 / (int)sizeof(REAL)) {
+        VEC512 sum = VEC512_OP(setzero)();
+        for (d = 0; d < dim; d++) {
+            VEC512 diff = VEC512_OP(sub)(VEC512_OP(load)(centers + (size_t)d * padded + c), VEC512_OP(set1)(vector[d]));
+            sum = VEC512_OP(add)(sum, VEC512_OP(mul)(diff, diff));
+        }
+        VEC512_OP(store)(out + c, sum);
+    }
+}
+#endif
+
+/* Pick the widest distance kernel the running CPU supports. */
+static FN(DistanceKernel) FN(select_distance_kernel)(void) {
+#ifdef KMEANS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return FN(distances_avx512);
+    if (__builtin_cpu_supports("avx2")) return FN(distances_avx2);
+#endif
+    return FN(distances_scalar);
+}
+
+/* Lay the centroids out lane by lane in the dim x padded block the kernels read. */
+static void FN(transpose_centroids)(const MATRIX* clusters, MATRIX* centers) {
+    int i, j;
+    for (i = 0; i < clusters->rows; i++)
+        for (j = 0; j < clusters->cols; j++)
+            MAT(centers, j, i) = MAT(clusters, i, j);
+}
+
+/* Nearest of the k centroids in centers to vector, the lowest index on ties. dist receives the
+squared distance to every centroid. */
+static int FN(nearest_centroid)(FN(DistanceKernel) distances_to, const REAL* vector, const MATRIX* centers, int k, REAL* dist) {
+    int j, nearest = 0;
+    distances_to(vector, centers->data, centers->rows, centers->stride, dist);
+    for (j = 1; j < k; j++) {
+        if (dist[j] < dist[nearest])
+            nearest = j;
+    }
+    return nearest;
+}
+
+/* Half the distance from every centroid to its nearest other one, rounded down by slack. */
+static void FN(compute_half_gaps)(const MATRIX* clusters, double* halfGap, double slack) {
+    int i, j, k = clusters->rows;
+#pragma omp parallel for private(j) schedule(static)
+    for (i = 0; i < k; i++) {
+        double nearest = HUGE_VAL;
+        for (j = 0; j < k; j++) {
+            double dist = j == i ? HUGE_VAL : FN(squaredDistance)(MAT_ROW(clusters, i), MAT_ROW(clusters, j), clusters->cols);
+            if (dist < nearest) nearest = dist;
+        }
+        halfGap[i] = 0.5 * sqrt(nearest) * (1 - slack);
+    }
+}
+
+/* Lloyd's k-means from the given centroids, which are updated in place. With accelerated set,
+Hamerly's bounds skip the distance computations of vectors that provably keep their centroid;
+every bound is loosened by REAL_SLACK to absorb rounding, so the assignments and the result
+are identical to Lloyd's. Touches no Python objects, so it can run without the GIL.
+Params: labels (n) & inertia - if not NULL, receive the nearest final centroid of every vector
+and the sum of squared distances to it. Ret: 0 on success, 1 on allocation failure. */
+int FN(kmeans_lloyd)(const MATRIX *vectors, MATRIX *clusters, int maxIter, double eps, int accelerated, int *labels, double *inertia) {
+    int *clusterSizes, *partialSizes;
+    Matrix *sums, *partialSums; /* Coordinate sums are kept in double whatever REAL is */
+    MATRIX *prevClusters, *centers, *distances;
+    int i, j, t, iter, converged = 0;
+    double shift;
+    int k = clusters->rows, dim = clusters->cols, vector_count = vectors->rows;
+    int threads = THREAD_COUNT(), padded = (k + REAL_LANES - 1) / REAL_LANES * REAL_LANES;
+    FN(DistanceKernel) distances_to = FN(select_distance_kernel)();
+    Bounds* bounds = NULL;
+
+    /* Create previous clusters matrix - k x dim */
+    prevClusters = FN(create_matrix)(k, dim);
+
+    /* Initiliaze sums matrix - k x dim, clusterSize 1d array - k,
+       their per thread partials and the transposed centroid block - dim x padded */
+    sums = create_matrix(k, dim);
+    clusterSizes = calloc(k, sizeof(int));
+    partialSums = create_matrix(threads * k, dim);
+    partialSizes = malloc((size_t)threads * k * sizeof(int));
+    centers = FN(create_matrix)(dim, padded);
+    distances = FN(create_matrix)(threads, padded);
+    if (accelerated) bounds = create_bounds(vector_count, k, REAL_SLACK(dim));
+    if (!prevClusters || !sums || !clusterSizes || !partialSums || !partialSizes || !centers || !distances
+        || (accelerated && !bounds)) {
+        FN(destroy_matrix)(prevClusters);
+        destroy_matrix(sums);
+        free(clusterSizes);
+        destroy_matrix(partialSums);
+        free(partialSizes);
+        FN(destroy_matrix)(centers);
+        FN(destroy_matrix)(distances);
+        destroy_bounds(bounds);
+        return 1;
+    }
+    memset(centers->data, 0, (size_t)dim * padded * sizeof(REAL)); /* Padding lanes stay zero */
+
+    for (iter = 0; iter < maxIter && !converged; iter++) {
+        /* Reset the partial sums and sizes, lay the centroids out lane by lane*/
+        memset(partialSums->data, 0, (size_t)threads * k * dim * sizeof(double));
+        memset(partialSizes, 0, (size_t)threads * k * sizeof(int));
+        FN(transpose_centroids)(clusters, centers);
+        if (bounds && iter > 0) FN(compute_half_gaps)(clusters, bounds->halfGap, bounds->slack);
+
+        /*Assign vectors to clusters, each thread into its own partial sums*/
+#pragma omp parallel private(i, j)
+        {
+            int thread = THREAD_ID();
+            REAL *dist = MAT_ROW(distances, thread);
+            double *threadSums = MAT_ROW(partialSums, (size_t)thread * k);
+            int *threadSizes = partialSizes + (size_t)thread * k;
+
+#pragma omp for schedule(static)
+            for (i = 0; i < vector_count; i++) {
+                const REAL *vector = MAT_ROW(vectors, i);
+                double *sum;
+                int minCluster = -1;
+
+                if (bounds && iter > 0) { /* Keep the centroid if no other one can be as close*/
+                    int a = bounds->assigned[i];
+                    double limit = bounds->halfGap[a] > bounds->lower[i] ? bounds->halfGap[a] : bounds->lower[i];
+                    if (bounds->upper[i] < limit) minCluster = a;
+                    else {
+                        bounds->upper[i] = sqrt(FN(squaredDistance)(vector, MAT_ROW(clusters, a), dim)) * (1 + bounds->slack);
+                        if (bounds->upper[i] < limit) minCluster = a;
+                    }
+                }
+                if (minCluster < 0) {
+                    minCluster = FN(nearest_centroid)(distances_to, vector, centers, k, dist);
+                    if (bounds) {
+                        double second = HUGE_VAL;
+                        for (j = 0; j < k; j++) {
+                            if (j != minCluster && dist[j] < second)
+                                second = dist[j];
+                        }
+                        bounds->assigned[i] = minCluster;
+                        bounds->upper[i] = sqrt(dist[minCluster]) * (1 + bounds->slack);
+                        bounds->lower[i] = sqrt(second) * (1 - bounds->slack);
+                    }
+                }
+
+                threadSizes[minCluster]++;
+                sum = threadSums + (size_t)minCluster * dim;
+                for (j = 0; j < dim; j++) {
+                    sum[j] += vector[j];
+                }
+            }
+        }
+
+        /* Reduce the partials in thread order*/
+        memcpy(sums->data, partialSums->data, (size_t)k * dim * sizeof(double));
+        memcpy(clusterSizes, partialSizes, k * sizeof(int));
+        for (t = 1; t < threads; t++) {
+            const double *partial = MAT_ROW(partialSums, (size_t)t * k);
+            for (i = 0; i < k * dim; i++)
+                sums->data[i] += partial[i];
+            for (i = 0; i < k; i++)
+                clusterSizes[i] += partialSizes[(size_t)t * k + i];
+        }
+
+        converged = 1;
+        /* Update clusters*/
+        for (i = 0; i < k; i++) {
+            REAL *cluster = MAT_ROW(clusters, i), *prev = MAT_ROW(prevClusters, i);
+            double *sum = MAT_ROW(sums, i);
+            for (j = 0; j < dim; j++) {
+                prev[j] = cluster[j];
+                cluster[j] = clusterSizes[i] ? sum[j] / clusterSizes[i] : cluster[j];
+            }
+
+            shift = FN(squaredDistance)(cluster, prev, dim);
+            if (shift > eps * eps)
+                converged = 0;
+            if (bounds) bounds->shift[i] = sqrt(shift) * (1 + bounds->slack);
+        }
+        if (bounds && !converged) move_bounds(bounds, vector_count, k);
+    }
+
+    if (labels || inertia) { /* Final assignment against the final centroids*/
+        double total = 0;
+        FN(transpose_centroids)(clusters, centers);
+#pragma omp parallel private(i) reduction(+:total)
+        {
+            REAL *dist = MAT_ROW(distances, THREAD_ID());
+#pragma omp for schedule(static)
+            for (i = 0; i < vector_count; i++) {
+                int nearest = FN(nearest_centroid)(distances_to, MAT_ROW(vectors, i), centers, k, dist);
+                if (labels) labels[i] = nearest;
+                total += dist[nearest];
+            }
+        }
+        if (inertia) *inertia = total;
+    }
+
+    /* Free memory*/
+    destroy_matrix(sums);
+    FN(destroy_matrix)(prevClusters);
+    free(clusterSizes);
+    destroy_matrix(partialSums);
+    free(partialSizes);
+    FN(destroy_matrix)(centers);
+    FN(destroy_matrix)(distances);
+    destroy_bounds(bounds);
+    return 0;
+}
+
+#undef REAL_LANES
+#undef REAL_EPSILON
+#undef REAL_SLACK
+#undef REAL
+#undef MATRIX
+#undef FN
+#undef VEC256
+#undef VEC256_OP
+#undef VEC512
+#undef VEC512_OP
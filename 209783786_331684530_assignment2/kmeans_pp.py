@@ -1,12 +1,12 @@
 import sys
 import os
-import math
 import numpy as np
 import mykmeanssp
 
 
 EPSILON = 0.001
 DEFAULT_ITERATIONS = "200"
+SEED = 1234
 
 def processInput():
     if not 5 <= len(sys.argv) <= 6:
@@ -81,39 +81,14 @@ def processFiles(file1, file2):
 
     
 def main():
-    np.random.seed(1234)
-
     K, iter, eps, vectors, N = processInput()
 
-
-    weights = np.ones(N)
-    centroidIndexes = np.zeros(K, dtype=int)
-    
-    choice = np.random.choice(N)
-    centroidIndexes[0] = choice
-    weights[choice] = 0
-    currentCentroidCount = 1
-
-    while currentCentroidCount < K:
-        for i in range(N):
-            if weights[i] == 0:
-                continue
-            minDist = math.inf
-            for centroid in range(currentCentroidCount):
-                dist = np.linalg.norm(vectors[i] - vectors[centroidIndexes[centroid]])
-                if dist < minDist:
-                    minDist = dist
-            weights[i] = minDist
-        
-        choice = np.random.choice(N, p=weights/weights.sum())
-        centroidIndexes[currentCentroidCount] = choice
-        weights[choice] = 0
-        currentCentroidCount += 1
+    # k-means++ seeding in C, the same choices as np.random.seed(SEED) gave the former Python loop
+    centroidIndexes = mykmeanssp.init_pp(vectors, K, SEED)
     
     print(','.join([str(index) for index in centroidIndexes]))
-    print("python {:.4f}".format(eps))
-    result = mykmeanssp.fit( vectors.tolist() , [vectors[index].tolist() for index in centroidIndexes] ,K, iter, eps)
-    for cluster in result:
+    centroids, labels, inertia = mykmeanssp.fit(vectors, vectors[centroidIndexes], K, iter, eps)
+    for cluster in centroids:
         print(','.join(["{:.4f}".format(centroid) for centroid in cluster]))
 
 
@@ -1,158 +1,361 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 #include "kmeans.h"
 
-#define PY_SSIZE_T_CLEAN
-#include <Python.h>
-
-// Function to convert a Python list of lists to a C 2D double array
-double** python_list_of_lists_to_double_array(PyObject* py_list, size_t* outer_size, size_t** inner_sizes) {
+// Function to convert a Python list of lists to a contiguous C matrix
+Matrix* python_list_of_lists_to_matrix(PyObject* py_list) {
     if (!PyList_Check(py_list)) {
         printf("Error: The provided Python object is not a list.\n");
         return NULL;
     }
 
-    *outer_size = PyList_Size(py_list);
-    *inner_sizes = (size_t*)malloc((*outer_size) * sizeof(size_t));
-    if (!(*inner_sizes)) {
-        printf("Error: Memory allocation failed for inner_sizes.\n");
+    Py_ssize_t outer_size = PyList_Size(py_list);
+    Py_ssize_t cols = outer_size ? PyObject_Length(PyList_GetItem(py_list, 0)) : 0;
+    if (cols < 0) {
+        printf("Error: Element 0 is not a list.\n");
         return NULL;
     }
 
-    double** c_array = (double**)malloc((*outer_size) * sizeof(double*));
-    if (!c_array) {
-        printf("Error: Memory allocation failed for c_array.\n");
-        free(*inner_sizes);
+    Matrix* matrix = create_matrix((int)outer_size, (int)cols);
+    if (!matrix) {
+        printf("Error: Memory allocation failed for matrix.\n");
         return NULL;
     }
 
-    for (size_t i = 0; i < *outer_size; i++) {
+    for (Py_ssize_t i = 0; i < outer_size; i++) {
         PyObject* inner_list = PyList_GetItem(py_list, i);
-        if (!PyList_Check(inner_list)) {
-            printf("Error: Element %zu is not a list.\n", i);
-            free(*inner_sizes);
-            free(c_array);
+        if (!PyList_Check(inner_list) || PyList_Size(inner_list) != cols) {
+            printf("Error: Element %zd is not a list of length %zd.\n", i, cols);
+            destroy_matrix(matrix);
             return NULL;
         }
 
-        (*inner_sizes)[i] = PyList_Size(inner_list);
-        c_array[i] = (double*)malloc((*inner_sizes)[i] * sizeof(double));
-        if (!c_array[i]) {
-            printf("Error: Memory allocation failed for inner array %zu.\n", i);
-            free(*inner_sizes);
-            for (size_t j = 0; j < i; j++) {
-                free(c_array[j]);
-            }
-            free(c_array);
-            return NULL;
-        }
-
-        for (size_t j = 0; j < (*inner_sizes)[i]; j++) {
+        double* row = MAT_ROW(matrix, i);
+        for (Py_ssize_t j = 0; j < cols; j++) {
             PyObject* item = PyList_GetItem(inner_list, j);
             if (PyFloat_Check(item) || PyLong_Check(item)) {
-                c_array[i][j] = PyFloat_AsDouble(item);
+                row[j] = PyFloat_AsDouble(item);
                 if (PyErr_Occurred()) {
-                    printf("Error: Failed to convert item at [%zu][%zu] to double.\n", i, j);
-                    free(*inner_sizes);
-                    for (size_t k = 0; k <= i; k++) {
-                        free(c_array[k]);
-                    }
-                    free(c_array);
+                    printf("Error: Failed to convert item at [%zd][%zd] to double.\n", i, j);
+                    destroy_matrix(matrix);
                     return NULL;
                 }
             } else {
-                printf("Error: Element [%zu][%zu] is not numeric.\n", i, j);
-                free(*inner_sizes);
-                for (size_t k = 0; k <= i; k++) {
-                    free(c_array[k]);
-                }
-                free(c_array);
+                printf("Error: Element [%zd][%zd] is not numeric.\n", i, j);
+                destroy_matrix(matrix);
                 return NULL;
             }
         }
     }
 
-    return c_array;
+    return matrix;
 }
 
-// Function exposed to Python
-static PyObject* fit(PyObject* self, PyObject* args) {
-    PyObject *list1, *list2;
-    int k, maxIter;
-    double eps;
+// Whether a buffer format string describes native float64
+static int is_double_format(const char* format) {
+    if (!format) return 0;
+    if (*format == '@' || *format == '=' || (*format == '<' && PY_LITTLE_ENDIAN)) format++;
+    return !strcmp(format, "d");
+}
 
-    // Parse arguments: two lists of lists followed by three integers
-    if (!PyArg_ParseTuple(args, "OOiid", &list1, &list2, &k, &maxIter, &eps)) {
+// Function to view a 2D float64 buffer (ndarray, np.memmap, ...) as a Matrix without copying. Rows may be padded but
+// each must be contiguous. On success view holds the buffer until PyBuffer_Release; NULL (python error set) on failure.
+static Matrix* buffer_to_matrix(PyObject* obj, Py_buffer* view, int writable) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_STRIDES | PyBUF_FORMAT | (writable ? PyBUF_WRITABLE : 0)) < 0) {
+        return NULL;
+    }
+    Py_ssize_t rows = view->ndim == 2 ? view->shape[0] : 0, cols = view->ndim == 2 ? view->shape[1] : 0;
+    Py_ssize_t stride = rows > 1 ? view->strides[0] : cols * (Py_ssize_t)sizeof(double);
+    if (view->ndim != 2 || !is_double_format(view->format) || rows > INT_MAX || cols > INT_MAX
+        || (cols > 1 && view->strides[1] != sizeof(double)) || stride % sizeof(double) || stride < cols * (Py_ssize_t)sizeof(double)) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "Expected a 2D float64 array with contiguous rows.");
         return NULL;
     }
-    printf("c module epsilon: %f\n", eps);
 
-    // Convert the first list of lists to a C array
-    size_t outer_size1;
-    size_t* inner_sizes_1;
-    double** array1 = python_list_of_lists_to_double_array(list1, &outer_size1, &inner_sizes_1);
-    if (!array1) {
-        PyErr_SetString(PyExc_ValueError, "Failed to convert first list of lists to C array.");
+    Matrix* matrix = wrap_matrix((double*)view->buf, (int)rows, (int)cols, (int)(stride / sizeof(double)));
+    if (!matrix) {
+        PyBuffer_Release(view);
+        PyErr_NoMemory();
+    }
+    return matrix;
+}
+
+// Function to get the writable float64 vector of per centroid counts, of length k. Ret: 1 on success, 0 on failure.
+static int get_counts(PyObject* obj, Py_buffer* view, int k) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) < 0) {
+        return 0;
+    }
+    if (view->ndim != 1 || !is_double_format(view->format) || view->shape[0] != k) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "counts must be a writable float64 array with one entry per centroid.");
+        return 0;
+    }
+    return 1;
+}
+
+// Function to fold one array of rows into the centroids, without the GIL. Ret: 1 on success, 0 on failure.
+static int feed_batch(MiniBatch** state, Matrix* centroids, double* counts, const Matrix* batch, int batch_size) {
+    if (batch->cols != centroids->cols) {
+        PyErr_SetString(PyExc_ValueError, "Batch rows do not match the centroid dimension.");
+        return 0;
+    }
+    if (!*state && !(*state = create_minibatch(centroids->rows, centroids->cols, batch_size))) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    minibatch_update(*state, centroids, counts, batch);
+    Py_END_ALLOW_THREADS
+    return 1;
+}
+
+// Mini-batch k-means over one batch: partial_fit(centroids, counts, batch), all float64 arrays. Moves the k x dim
+// centroids towards the nearest rows of batch, updating centroids and counts (rows absorbed per centroid) in place.
+static PyObject* partial_fit(PyObject* self, PyObject* args) {
+    PyObject *centroidsObj, *countsObj, *batchObj;
+    Py_buffer centroidsView, countsView, batchView;
+    MiniBatch* state = NULL;
+    int ok = 0;
+
+    if (!PyArg_ParseTuple(args, "OOO", &centroidsObj, &countsObj, &batchObj)) {
+        return NULL;
+    }
+    Matrix* centroids = buffer_to_matrix(centroidsObj, &centroidsView, 1);
+    if (!centroids) {
+        return NULL;
+    }
+    if (centroids->rows > 0 && get_counts(countsObj, &countsView, centroids->rows)) {
+        Matrix* batch = buffer_to_matrix(batchObj, &batchView, 0);
+        if (batch) {
+            ok = batch->rows == 0 || feed_batch(&state, centroids, (double*)countsView.buf, batch, batch->rows);
+            destroy_matrix(batch);
+            PyBuffer_Release(&batchView);
+        }
+        PyBuffer_Release(&countsView);
+    } else if (centroids->rows == 0) {
+        PyErr_SetString(PyExc_ValueError, "At least one centroid is needed.");
+    }
+    destroy_minibatch(state);
+    destroy_matrix(centroids);
+    PyBuffer_Release(&centroidsView);
+    if (!ok) {
         return NULL;
     }
-    int vector_amount = PyObject_Length(list1);
-    // int dim = 7;
-    int dim = PyObject_Length(PyList_GetItem(list1, 0));
+    Py_RETURN_NONE;
+}
 
-    // Convert the second list of lists to a C array
-    size_t outer_size2;
-    size_t* inner_sizes2;
-    double** array2 = python_list_of_lists_to_double_array(list2, &outer_size2, &inner_sizes2);
-    if (!array2) {
-        PyErr_SetString(PyExc_ValueError, "Failed to convert second list of lists to C array.");
+// Streaming mini-batch k-means: fit_minibatch(data, centroids, counts, batch_size=4096, epochs=1). data is either a 2D
+// float64 array (an np.memmap is paged in one batch at a time, never copied) swept epochs times in batches of
+// batch_size rows, or an iterable of such arrays consumed once. centroids and counts are updated in place.
+static PyObject* fit_minibatch(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"data", "centroids", "counts", "batch_size", "epochs", NULL};
+    PyObject *dataObj, *centroidsObj, *countsObj;
+    Py_buffer centroidsView, countsView, dataView;
+    int batch_size = DEFAULT_BATCH_SIZE, epochs = 1, ok = 1;
+    MiniBatch* state = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|ii", kwlist, &dataObj, &centroidsObj, &countsObj, &batch_size, &epochs)) {
+        return NULL;
+    }
+    if (batch_size < 1 || epochs < 0) {
+        PyErr_SetString(PyExc_ValueError, "batch_size must be positive and epochs not negative.");
+        return NULL;
+    }
+    int sweepable = PyObject_CheckBuffer(dataObj);
+    if (!sweepable && epochs != 1) {
+        PyErr_SetString(PyExc_ValueError, "An iterable of batches can only be consumed once (epochs=1).");
+        return NULL;
+    }
+    Matrix* centroids = buffer_to_matrix(centroidsObj, &centroidsView, 1);
+    if (!centroids) {
+        return NULL;
+    }
+    if (centroids->rows == 0 || !get_counts(countsObj, &countsView, centroids->rows)) {
+        if (centroids->rows == 0) PyErr_SetString(PyExc_ValueError, "At least one centroid is needed.");
+        destroy_matrix(centroids);
+        PyBuffer_Release(&centroidsView);
         return NULL;
     }
+    double* counts = (double*)countsView.buf;
 
-    /*
-    // Print data for demonstration
-    printf("First List of Lists:\n");
-    for (size_t i = 0; i < outer_size1; i++) {
-        printf("[");
-        for (size_t j = 0; j < inner_sizes_1[i]; j++) {
-            printf("%0.4f", array1[i][j]);
-            if (j < inner_sizes_1[i] - 1) printf(", ");
+    if (sweepable) { // One array: batches are row slices of it
+        Matrix* data = buffer_to_matrix(dataObj, &dataView, 0);
+        if (!data) {
+            ok = 0;
+        } else {
+            for (int epoch = 0; epoch < epochs && ok; epoch++) {
+                for (int first = 0; first < data->rows && ok; first += batch_size) {
+                    Matrix batch = *data;
+                    batch.data = MAT_ROW(data, first);
+                    batch.rows = data->rows - first < batch_size ? data->rows - first : batch_size;
+                    batch.owner = 0;
+                    ok = feed_batch(&state, centroids, counts, &batch, batch_size);
+                }
+            }
+            destroy_matrix(data);
+            PyBuffer_Release(&dataView);
         }
-        printf("]\n");
+    } else { // An iterator of batches
+        PyObject* iterator = PyObject_GetIter(dataObj);
+        PyObject* item;
+        ok = iterator != NULL;
+        while (ok && (item = PyIter_Next(iterator))) {
+            Matrix* batch = buffer_to_matrix(item, &dataView, 0);
+            ok = batch && (batch->rows == 0 || feed_batch(&state, centroids, counts, batch, batch_size));
+            if (batch) {
+                destroy_matrix(batch);
+                PyBuffer_Release(&dataView);
+            }
+            Py_DECREF(item);
+        }
+        if (PyErr_Occurred()) ok = 0;
+        Py_XDECREF(iterator);
+    }
+
+    destroy_minibatch(state);
+    destroy_matrix(centroids);
+    PyBuffer_Release(&centroidsView);
+    PyBuffer_Release(&countsView);
+    if (!ok) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// k-means++ seeding: init_pp(vectors, k, seed, method="kmeans++", trials=0, oversampling=0.0, rounds=5). vectors is a
+// 2D float64 array; method is "kmeans++" (the choices np.random.seed(seed) gave the Python loop), "greedy" (trials
+// candidates per step, 0 for 2 + log k) or "parallel" (k-means||, oversampling 0 for 2k). Returns the k row indices.
+static PyObject* init_pp(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char* kwlist[] = {"vectors", "k", "seed", "method", "trials", "oversampling", "rounds", NULL};
+    PyObject* vectorsObj;
+    Py_buffer view;
+    int k, trials = 0, rounds = DEFAULT_SEEDING_ROUNDS, method, status;
+    unsigned long seed;
+    const char* methodName = "kmeans++";
+    double oversampling = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oik|sidi", kwlist, &vectorsObj, &k, &seed, &methodName, &trials,
+                                     &oversampling, &rounds)) {
+        return NULL;
+    }
+    if (!strcmp(methodName, "kmeans++")) method = SEEDING_STANDARD;
+    else if (!strcmp(methodName, "greedy")) method = SEEDING_GREEDY;
+    else if (!strcmp(methodName, "parallel")) method = SEEDING_PARALLEL;
+    else {
+        PyErr_SetString(PyExc_ValueError, "method must be 'kmeans++', 'greedy' or 'parallel'.");
+        return NULL;
+    }
+    if (seed > 0xffffffffUL || rounds < 0) {
+        PyErr_SetString(PyExc_ValueError, "seed must be between 0 and 2**32 - 1 and rounds not negative.");
+        return NULL;
+    }
+    Matrix* vectors = buffer_to_matrix(vectorsObj, &view, 0);
+    if (!vectors) {
+        return NULL;
+    }
+    int* indices = k > 0 ? malloc((size_t)k * sizeof(int)) : NULL;
+    if (k < 1 || k > vectors->rows) {
+        status = 2;
+    } else if (!indices) {
+        status = 1;
+    } else {
+        Py_BEGIN_ALLOW_THREADS
+        status = kmeans_pp_init(vectors, k, (uint32_t)seed, method, trials, oversampling, rounds, indices);
+        Py_END_ALLOW_THREADS
     }
+    destroy_matrix(vectors);
+    PyBuffer_Release(&view);
 
-    printf("Second List of Lists:\n");
-    for (size_t i = 0; i < outer_size2; i++) {
-        printf("[");
-        for (size_t j = 0; j < inner_sizes2[i]; j++) {
-            printf("%0.4f", array2[i][j]);
-            if (j < inner_sizes2[i] - 1) printf(", ");
+    PyObject* result = NULL;
+    if (status == 1) {
+        PyErr_NoMemory();
+    } else if (status == 2) {
+        PyErr_SetString(PyExc_ValueError, "Cannot choose k distinct centroids from these vectors.");
+    } else if ((result = PyList_New(k))) {
+        for (int i = 0; i < k; i++) {
+            PyList_SET_ITEM(result, i, PyLong_FromLong(indices[i]));
         }
-        printf("]\n");
-        free(array2[i]); // Free inner arrays
     }
+    free(indices);
+    return result;
+}
 
-     printf("Integers: %d, %d, %d, %f\n", k, maxIter, inner_sizes_1, eps);
-     */
+// The array bridges, instantiated once per element type from kmeansmodule_bridges.h
+#define REAL double
+#define MATRIX Matrix
+#define NPY_REAL NPY_FLOAT64
+#define FN(name) name
+#include "kmeansmodule_bridges.h"
 
-    PyObject* clusters = kmeans_c(array1, array2, k, maxIter, eps, dim, vector_amount);
+#define REAL float
+#define MATRIX FloatMatrix
+#define NPY_REAL NPY_FLOAT32
+#define FN(name) name##_f
+#include "kmeansmodule_bridges.h"
 
-    /* Free memory*/
-    for (size_t i = 0; i < outer_size1; i++) free(array1[i]);
-    free(array1);
-    free(inner_sizes_1);
+// Function exposed to Python
+static PyObject* fit(PyObject* self, PyObject* args) {
+    PyObject *list1, *list2;
+    int k, maxIter, accelerated = 0;
+    double eps;
+
+    // Parse arguments: two lists of lists, k, maxIter, eps and optionally the accelerated flag
+    if (!PyArg_ParseTuple(args, "OOiid|p", &list1, &list2, &k, &maxIter, &eps, &accelerated)) {
+        return NULL;
+    }
+    if (!PyList_Check(list1) || !PyList_Check(list2)) { // Arrays in, arrays out, float32 vectors in single precision
+        if (PyArray_Check(list1) && PyArray_TYPE((PyArrayObject*)list1) == NPY_FLOAT32) {
+            return fit_arrays_f(list1, list2, k, maxIter, eps, accelerated);
+        }
+        return fit_arrays(list1, list2, k, maxIter, eps, accelerated);
+    }
 
-    for (size_t i = 0; i < outer_size2; i++) free(array2[i]);
-    free(array2);
-    free(inner_sizes2);
+    // Convert the first list of lists to a C matrix
+    Matrix* vectors = python_list_of_lists_to_matrix(list1);
+    if (!vectors) {
+        PyErr_SetString(PyExc_ValueError, "Failed to convert first list of lists to C array.");
+        return NULL;
+    }
 
-    
+    // Convert the second list of lists to a C matrix
+    Matrix* clusters = python_list_of_lists_to_matrix(list2);
+    if (!clusters) {
+        destroy_matrix(vectors);
+        PyErr_SetString(PyExc_ValueError, "Failed to convert second list of lists to C array.");
+        return NULL;
+    }
+    if (clusters->rows != k || clusters->cols != vectors->cols) {
+        destroy_matrix(vectors);
+        destroy_matrix(clusters);
+        PyErr_SetString(PyExc_ValueError, "Cluster list does not match k and the vector dimension.");
+        return NULL;
+    }
+
+    PyObject* result = kmeans_c(vectors, clusters, maxIter, eps, accelerated);
+
+    /* Free memory*/
+    destroy_matrix(vectors);
+    destroy_matrix(clusters);
 
-    return clusters; 
+    return result; 
 }
 
 // Method definition table
 static PyMethodDef kmeans_methods[] = {
-    {"fit", fit, METH_VARARGS, "Recieves: vector_lst, cluster_lst, k, maxIter, eps and activates k-means algorithm"},
+    {"fit", fit, METH_VARARGS, "Recieves: vector_lst, cluster_lst, k, maxIter, eps[, accelerated] and activates k-means algorithm."
+     " Given arrays instead of lists, returns (centroids, labels, inertia), float32 vectors are clustered in float32"},
+    {"init_pp", (PyCFunction)(void (*)(void))init_pp, METH_VARARGS | METH_KEYWORDS,
+     "Recieves: vectors (float64 array), k, seed[, method, trials, oversampling, rounds] and returns k-means++ centroid indices"},
+    {"partial_fit", partial_fit, METH_VARARGS, "Recieves: centroids, counts, batch (float64 arrays) and folds the batch into the centroids in place"},
+    {"fit_minibatch", (PyCFunction)(void (*)(void))fit_minibatch, METH_VARARGS | METH_KEYWORDS,
+     "Recieves: data (array or iterable of arrays), centroids, counts, batch_size=4096, epochs=1 and runs mini-batch k-means in place"},
     {NULL, NULL, 0, NULL}
 };
 
@@ -168,6 +371,7 @@ static struct PyModuleDef kmeans_module = {
 // Module initialization
 PyMODINIT_FUNC PyInit_mykmeanssp(void) {
     PyObject *m;
+    import_array();
     m = PyModule_Create(&kmeans_module);
     if (!m) {
         return NULL;
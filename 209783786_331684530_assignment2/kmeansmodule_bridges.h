@@ -0,0 +1,83 @@
+// Type-generic NumPy bridges of kmeansmodule.c. Not a standalone header: kmeansmodule.c includes it once per
+// element type after defining REAL (the element type), MATRIX (the matching matrix type), NPY_REAL (its NumPy type
+// number) and FN(name) (the function name for the type, the same suffix kmeans.c gives its kernels), which are
+// undefined again at the end.
+
+// Function to view a 2D REAL array (an np.memmap included) as a matrix without copying when its rows are contiguous;
+// other real arrays (ints, strided views, the other float width) are converted once. keep receives the array holding the data.
+// Ret: the matrix, NULL (python error set) on failure.
+static MATRIX* FN(borrow_array)(PyObject* obj, PyArrayObject** keep) {
+    PyArrayObject* source = (PyArrayObject*)PyArray_FROM_OTF(obj, NPY_REAL, NPY_ARRAY_ALIGNED);
+    if (!source) {
+        return NULL;
+    }
+    if (PyArray_NDIM(source) != 2 || PyArray_DIM(source, 0) > INT_MAX || PyArray_DIM(source, 1) > INT_MAX) {
+        Py_DECREF(source);
+        PyErr_SetString(PyExc_ValueError, "Expected a 2D array.");
+        return NULL;
+    }
+    int rows = (int)PyArray_DIM(source, 0), cols = (int)PyArray_DIM(source, 1);
+    npy_intp row_stride = rows > 1 ? PyArray_STRIDE(source, 0) : (npy_intp)(cols * sizeof(REAL)); // As buffer_to_matrix
+    npy_intp col_stride = PyArray_STRIDE(source, 1);
+
+    if ((cols > 1 && col_stride != sizeof(REAL)) || row_stride % sizeof(REAL) || row_stride < (npy_intp)(cols * sizeof(REAL))) {
+        Py_SETREF(source, (PyArrayObject*)PyArray_FROM_OTF((PyObject*)source, NPY_REAL, NPY_ARRAY_IN_ARRAY)); // The one copy
+        if (!source) {
+            return NULL;
+        }
+        row_stride = cols * sizeof(REAL);
+    }
+
+    MATRIX* matrix = FN(wrap_matrix)((REAL*)PyArray_DATA(source), rows, cols, (int)(row_stride / sizeof(REAL)));
+    if (!matrix) {
+        Py_DECREF(source);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    *keep = source;
+    return matrix;
+}
+
+// fit on arrays: returns (centroids, labels, inertia) - a new k x dim REAL array, the int array of every vector's
+// nearest final centroid and the sum of squared distances to it. The iterations run without the GIL.
+static PyObject* FN(fit_arrays)(PyObject* vectorsObj, PyObject* clustersObj, int k, int maxIter, double eps, int accelerated) {
+    PyArrayObject *vectorsArray, *centroids = NULL, *labels = NULL;
+    double inertia = 0;
+    int status = 1;
+
+    MATRIX* vectors = FN(borrow_array)(vectorsObj, &vectorsArray);
+    if (!vectors) {
+        return NULL;
+    }
+    // FORCECAST: float64 starting centroids are rounded once for a float32 fit
+    PyArrayObject* init = (PyArrayObject*)PyArray_FROM_OTF(clustersObj, NPY_REAL, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (init && (PyArray_NDIM(init) != 2 || PyArray_DIM(init, 0) != k || k < 1 || PyArray_DIM(init, 1) != vectors->cols)) {
+        PyErr_SetString(PyExc_ValueError, "Cluster array does not match k and the vector dimension.");
+    } else if (init) {
+        npy_intp count = vectors->rows;
+        centroids = (PyArrayObject*)PyArray_NewCopy(init, NPY_CORDER); // The result; the initial centroids stay as they were
+        labels = (PyArrayObject*)PyArray_SimpleNew(1, &count, NPY_INT);
+        MATRIX* clusters = centroids ? FN(wrap_matrix)((REAL*)PyArray_DATA(centroids), k, vectors->cols, vectors->cols) : NULL;
+        if (clusters && labels) {
+            Py_BEGIN_ALLOW_THREADS
+            status = FN(kmeans_lloyd)(vectors, clusters, maxIter, eps, accelerated, (int*)PyArray_DATA(labels), &inertia);
+            Py_END_ALLOW_THREADS
+        }
+        if (status && !PyErr_Occurred()) PyErr_NoMemory();
+        FN(destroy_matrix)(clusters);
+    }
+    Py_XDECREF(init);
+    FN(destroy_matrix)(vectors);
+    Py_DECREF(vectorsArray);
+    if (status) {
+        Py_XDECREF(centroids);
+        Py_XDECREF(labels);
+        return NULL;
+    }
+    return Py_BuildValue("(NNd)", centroids, labels, inertia);
+}
+
+#undef REAL
+#undef MATRIX
+#undef NPY_REAL
+#undef FN
@@ -1,7 +1,11 @@
 from setuptools import Extension, setup
+import numpy as np
 
-module = Extension("mykmeanssp", sources=['kmeansmodule.c'])
+# -ffp-contract=off keeps every distance kernel (scalar, AVX2, AVX-512) bit-identical
+module = Extension("mykmeanssp", sources=['kmeansmodule.c', 'kmeans.c'],
+                   depends=['kmeans.h', 'kmeans_kernels.h', 'kmeansmodule_bridges.h'], include_dirs=[np.get_include()],
+                   extra_compile_args=['-fopenmp', '-ffp-contract=off'], extra_link_args=['-fopenmp'])
 setup(name='kmeansmodule.c',
      version='1.0',
      description='Module to apply k-means algorithm',
-     ext_modules=[module])
\ No newline at end of file
+     ext_modules=[module])
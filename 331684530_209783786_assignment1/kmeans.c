@@ -1,28 +1,25 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
-
+#define READ_CHUNK 65536 /* Bytes read from stdin at a time*/
+#define MAX_TOKEN 512 /* Longest accepted number*/
 
 int DEFAULT_ITER = 200; 
-int BASE_EXP_START = 3;
 double CONVERGENCE_TARGET = 0.001;
 
 
 
 double getDistance(double a[],double b[],int dim);
+double *readVectors(FILE *in, int *vector_count, int *dim);
 
 int main(int argc, char **argv)
 {
     int i=0,j=0,k, maxIter; /* iterators and input*/
-    int dim=-1;
+    int dim=0;
     int vector_count=0;
-    char ch;
-    int scalarCount=0;
-    int baseExp=BASE_EXP_START; /* We add char by char, and this keeps track of the floating point*/
-    int sign = 1;
-    int thereWasPoint=0;
-    double currentScalar=0;
+    double *data;
     int converged ;
     int iter;
     double **vectors;
@@ -51,87 +48,21 @@ int main(int argc, char **argv)
 
   
     
-    i=0;
-        
-
-    while ((ch = getc(stdin)) != EOF) { /* Finding the dimension and vector count*/
-        if(ch==','){ /* End of scalar*/
-            i++;
-        }
-        if(ch == 10){ /* linebreak (takes into account that theres a linebreak at the end of the last line)*/
-            if(dim==-1){ /* first vector*/
-                dim = i+1; /*  plus 1 because we dont count the last scalar*/
-            }else{
-                if(dim != i+1){ /* non uniform dimension*/
-                    printf("An Error Has Occurred\n");
-                    return 1;
-                }
-            }
-            i=0;
-            vector_count++;
-        }
-        
+    data = readVectors(stdin, &vector_count, &dim); /* One pass, works on pipes too*/
+    if(data == NULL){
+        printf("An Error Has Occurred\n");
+        return 1;
     }
-    rewind(stdin); /* Reset the file pointer*/
 
     if(vector_count <= k || dim == 0){
         printf("Invalid number of clusters!\n");
+        free(data);
         return 1;
     }
- 
-    
-   
-    vectors = malloc(vector_count * sizeof(double *));
-    for(i = 0; i < vector_count; i++) {
-        vectors[i] = malloc(dim * sizeof(double));
-    }
 
-    i=0;
-    
-    
-
-    while ( i<vector_count  && (ch = getc(stdin)) != EOF) { /* processing all vectors*/
-        if(ch==','){ /* comma, end of scalar*/
-
-            if(!thereWasPoint){ /* Incase this is a whole number and we dont see a point, we should fix the floating point location here, see ch=="." case*/
-                currentScalar *= pow(10,-baseExp-1);
-            }
-            vectors[i][scalarCount]=currentScalar*sign; /*Pushing current char*/
-
-            currentScalar = 0; /* resetting helpers*/
-            thereWasPoint = 0;
-            sign = 1;
-            baseExp = BASE_EXP_START;
-            scalarCount++;
-        }else if(ch=='-'){
-            sign=-1;
-        }
-        else if(ch=='.'){
-            currentScalar *= pow(10,-baseExp-1); /* Fixing in hindsight the floating point location*/
-            baseExp = -1; /* Base for the next digit after the point*/
-            thereWasPoint = 1; 
-        }else if(ch == 10){ /* Line break*/
-            if(scalarCount!=dim-1 && scalarCount!=0){ /* Non uniform dimension*/
-                printf("An Error Has Occurred\n");
-                return 1;
-            }
-
-            if(!thereWasPoint){ /* Incase this is a whole number and we dont see a point, we should fix the floating point location here, see ch=="." case*/
-                currentScalar *= pow(10,-baseExp-1);
-            }
-            vectors[i][scalarCount]=currentScalar*sign; /* Updataing the last scalar*/
-
-            currentScalar = 0; /* resetting helpers*/
-            thereWasPoint = 0;
-            sign = 1;
-            baseExp = BASE_EXP_START;
-            scalarCount=0;
-
-            i++; /* incrementing vector count */
-        }else{ /* Normal digit, we sum it to the scalar with the current floating point location*/
-            currentScalar += (ch-'0')*pow(10,baseExp);
-            baseExp--;
-        }
+    vectors = malloc(vector_count * sizeof(double *)); /* Rows point into the contiguous buffer*/
+    for(i = 0; i < vector_count; i++) {
+        vectors[i] = data + (size_t)i * dim;
     }
 
 
@@ -209,7 +140,7 @@ int main(int argc, char **argv)
     }
 
     /* Free memory*/
-    for (i = 0; i < vector_count; i++) free(vectors[i]);
+    free(data);
     free(vectors);
 
     for (i = 0; i < k; i++) {
@@ -233,4 +164,95 @@ double getDistance(double a[], double b[], int dim) {
         sum += diff * diff;
     }
     return sqrt(sum);
-}
\ No newline at end of file
+}
+
+/* Exact powers of ten for the fast path of parseNumber*/
+static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/* Parse a whole NUL terminated token as a double. Plain decimals of up to 15 significant digits
+and a power of ten up to 22 are exact doubles, so one multiply or divide rounds correctly; any
+other token goes to strtod. Returns 0 if the token is not a number.*/
+int parseNumber(const char *token, double *value)
+{
+    const char *p = token;
+    double mantissa = 0;
+    int digits = 0, exponent = 0, any = 0, negative = 0;
+    char *end;
+
+    if (*p == '-' || *p == '+') negative = (*p++ == '-');
+    for (; *p >= '0' && *p <= '9'; p++, any = 1) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa != 0) digits++;
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++, any = 1) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0) digits++;
+            exponent--;
+        }
+    }
+    if (any && *p == '\0' && digits <= 15 && exponent >= -22) {
+        mantissa = exponent < 0 ? mantissa / POWERS_OF_TEN[-exponent] : mantissa;
+        *value = negative ? -mantissa : mantissa;
+        return 1;
+    }
+    *value = strtod(token, &end); /* Exponents, long mantissas, inf/nan...*/
+    return *token != '\0' && *end == '\0';
+}
+
+/* Read comma separated vectors from a stream in one pass (no rewind, so pipes work), growing a
+contiguous row-major buffer. Blank lines and carriage returns are skipped and the last line may
+lack its line break. Returns the buffer with the count and dimension set, NULL on a malformed
+number, rows of different lengths or allocation failure.*/
+double *readVectors(FILE *in, int *vector_count, int *dim)
+{
+    char *chunk = malloc(READ_CHUNK), token[MAX_TOKEN];
+    size_t got, c, count = 0, capacity = 1024;
+    double *data = malloc(capacity * sizeof(double));
+    int length = 0, fields = 0, failed = (chunk == NULL || data == NULL), done = 0;
+
+    *vector_count = 0;
+    *dim = 0;
+    while (!failed && !done) {
+        got = fread(chunk, 1, READ_CHUNK, in);
+        if (got == 0) { /* End of input ends the last line too*/
+            chunk[0] = '\n';
+            got = 1;
+            done = 1;
+        }
+        for (c = 0; c < got && !failed; c++) {
+            char ch = chunk[c];
+            if (ch == ',' || (ch == '\n' && (length > 0 || fields > 0))) { /* End of a scalar*/
+                token[length] = '\0';
+                if (count == capacity) {
+                    double *grown = realloc(data, 2 * capacity * sizeof(double));
+                    if (grown == NULL) {
+                        failed = 1;
+                        break;
+                    }
+                    data = grown;
+                    capacity *= 2;
+                }
+                if (!parseNumber(token, &data[count++])) failed = 1;
+                length = 0;
+                fields++;
+                if (ch == '\n') { /* End of a vector*/
+                    if (*dim == 0) *dim = fields;
+                    else if (fields != *dim) failed = 1; /* non uniform dimension*/
+                    fields = 0;
+                    (*vector_count)++;
+                }
+            } else if (ch != '\n' && ch != '\r') {
+                if (length == MAX_TOKEN - 1) failed = 1;
+                else token[length++] = ch;
+            }
+        }
+    }
+    free(chunk);
+    if (failed || ferror(in)) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
@@ -0,0 +1,102 @@
+import glob
+import os
+import sys
+
+import numpy as np
+import pytest
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, glob.glob(os.path.join(TESTS_DIR, "..", "*_*_assignment2"))[0])
+mykmeanssp = pytest.importorskip("mykmeanssp")  # Built by compile_and_run.sh
+import kmeans_pp
+
+
+def load_input(number):
+    """Joins the two db files of input_<number> the way kmeans_pp.py does. Ret: NumPy array."""
+    return kmeans_pp.processFiles(os.path.join(TESTS_DIR, f"input_{number}_db_1.txt"),
+                                  os.path.join(TESTS_DIR, f"input_{number}_db_2.txt"))
+
+
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15)])
+def test_hamerly_matches_lloyd(number, k):
+    vectors = load_input(number)
+    initial = vectors[mykmeanssp.init_pp(vectors, k, kmeans_pp.SEED)]
+    lloyd = mykmeanssp.fit(vectors, initial.copy(), k, 300, 0.0)
+    hamerly = mykmeanssp.fit(vectors, initial.copy(), k, 300, 0.0, True)
+    np.testing.assert_array_equal(hamerly[1], lloyd[1])
+    np.testing.assert_allclose(hamerly[0], lloyd[0], rtol=0, atol=1e-12)
+    assert hamerly[2] == pytest.approx(lloyd[2], rel=1e-12)
+
+
+@pytest.mark.parametrize("float_type", [np.float64, np.float32])
+def test_one_row_strided_fit_is_copied(float_type):
+    X = np.arange(8.0, dtype=float_type).reshape(1, 8)
+    centroids, labels, inertia = mykmeanssp.fit(X[:, ::2], X[:, ::2].copy(), 1, 10, 0.0)
+    np.testing.assert_array_equal(centroids, [[0.0, 2.0, 4.0, 6.0]])
+    np.testing.assert_array_equal(labels, [0])
+    assert inertia == 0
+
+
+def minibatch_start(vectors, k):
+    """Ret: the first k rows as float64 centroids and their zero counts."""
+    return vectors[:k].astype(np.float64), np.zeros(k)
+
+
+@pytest.mark.parametrize("source", ["ndarray", "memmap", "iterator"])
+def test_minibatch_sources_agree(source, tmp_path):
+    vectors, k, batch_size = load_input(3), 15, 64
+    expected, expected_counts = minibatch_start(vectors, k)
+    for first in range(0, len(vectors), batch_size):  # One partial_fit per batch is the reference
+        mykmeanssp.partial_fit(expected, expected_counts, vectors[first:first + batch_size])
+    if source == "memmap":
+        data = np.memmap(tmp_path / "vectors.bin", dtype=np.float64, mode="w+", shape=vectors.shape)
+        data[:] = vectors
+        data.flush()
+        data = np.memmap(tmp_path / "vectors.bin", dtype=np.float64, mode="r", shape=vectors.shape)
+    elif source == "iterator":
+        data = (vectors[first:first + batch_size] for first in range(0, len(vectors), batch_size))
+    else:
+        data = vectors
+    centroids, counts = minibatch_start(vectors, k)
+    mykmeanssp.fit_minibatch(data, centroids, counts, batch_size=batch_size)
+    np.testing.assert_array_equal(counts, expected_counts)
+    np.testing.assert_allclose(centroids, expected, rtol=0, atol=1e-12)
+    assert counts.sum() == len(vectors)
+
+
+def python_kmeans_pp(vectors, k, seed):
+    """The k-means++ loop kmeans_pp.py ran before init_pp. Ret: the k chosen row indices."""
+    np.random.seed(seed)
+    weights = np.ones(len(vectors))
+    indexes = [np.random.choice(len(vectors))]
+    weights[indexes[0]] = 0
+    while len(indexes) < k:
+        for i in range(len(vectors)):
+            if weights[i] != 0:
+                weights[i] = min(np.linalg.norm(vectors[i] - vectors[index]) for index in indexes)
+        indexes.append(np.random.choice(len(vectors), p=weights / weights.sum()))
+        weights[indexes[-1]] = 0
+    return indexes
+
+
+@pytest.mark.parametrize("number, k, seed", [(1, 3, 1234), (2, 7, 1234), (3, 15, 1234), (3, 4, 7)])
+def test_init_pp_matches_python_loop(number, k, seed):
+    vectors = load_input(number)
+    assert list(mykmeanssp.init_pp(vectors, k, seed)) == python_kmeans_pp(vectors, k, seed)
+
+
+@pytest.mark.parametrize("accelerated", [False, True])
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15)])
+def test_float32_fit_matches_float64(number, k, accelerated):
+    vectors = load_input(number)
+    initial = vectors[mykmeanssp.init_pp(vectors, k, kmeans_pp.SEED)]
+    double = mykmeanssp.fit(vectors, initial, k, 300, 0.0)
+    single = mykmeanssp.fit(vectors.astype(np.float32), initial.astype(np.float32), k, 300, 0.0, accelerated)
+    if accelerated:  # Hamerly's float32 bounds must not change a single float32 assignment
+        lloyd = mykmeanssp.fit(vectors.astype(np.float32), initial.astype(np.float32), k, 300, 0.0)
+        np.testing.assert_array_equal(single[1], lloyd[1])
+        np.testing.assert_array_equal(single[0], lloyd[0])
+    assert single[0].dtype == np.float32
+    np.testing.assert_array_equal(single[1], double[1])
+    np.testing.assert_allclose(single[0], double[0], rtol=1e-4, atol=1e-4)
+    assert single[2] == pytest.approx(double[2], rel=1e-4)
@@ -0,0 +1,229 @@
+import glob
+import os
+import sys
+
+import numpy as np
+import pytest
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, glob.glob(os.path.join(TESTS_DIR, "..", "*_*_project"))[0])
+symnmf = pytest.importorskip("symnmf")
+if not hasattr(symnmf, "norm"):  # symnmf.py found instead of the extension
+    pytest.skip("the symnmf extension is not built", allow_module_level=True)
+
+
+def load_input(number):
+    """Ret: the input_<number>.txt fixture as a NumPy array."""
+    return np.loadtxt(os.path.join(TESTS_DIR, f"input_{number}.txt"), delimiter=",")
+
+
+def initialize_H(W, k, seed):
+    """symnmf.py's initialization after np.random.seed(seed). Ret: n x k H."""
+    np.random.seed(seed)
+    return np.random.uniform(0, 2 * np.sqrt(np.mean(W) / k), (W.shape[0], k))
+
+
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15)])
+def test_float32_symnmf_matches_float64(number, k):
+    X = load_input(number)
+    W = symnmf.norm(X)
+    W32 = symnmf.norm(X.astype(np.float32))
+    assert W32.dtype == np.float32
+    np.testing.assert_allclose(W32, W, rtol=1e-4, atol=1e-6)
+    H0 = initialize_H(W, k, 1234)
+    H = symnmf.symnmf(W, H0)
+    H32 = symnmf.symnmf(W32, H0.astype(np.float32))
+    assert H32.dtype == np.float32
+    np.testing.assert_allclose(H32, H, rtol=1e-3, atol=1e-4)
+    np.testing.assert_array_equal(np.argmax(H32, axis=1), np.argmax(H, axis=1))
+
+
+@pytest.mark.parametrize("float_type", [np.float64, np.float32])
+def test_one_row_strided_input_is_copied(float_type):
+    W = np.array([[3.0]], dtype=float_type)
+    H = np.array([[1.0, 5.0, 2.0, 7.0]], dtype=float_type)
+    expected = symnmf.symnmf(W, H[:, ::2].copy(), max_iter=1)
+    np.testing.assert_array_equal(symnmf.symnmf(W, H[:, ::2], max_iter=1), expected)
+    np.testing.assert_allclose(expected, [[0.8, 1.6]], rtol=1e-6)
+    X = np.arange(8.0, dtype=float_type).reshape(1, 8)
+    np.testing.assert_array_equal(symnmf.symnmf_matrix_free(X[:, ::2], H[:, ::2], max_iter=1),
+                                  symnmf.symnmf_matrix_free(X[:, ::2].copy(), H[:, ::2].copy(), max_iter=1))
+
+
+def test_one_row_strided_out_is_rejected():
+    W, H = np.array([[3.0]]), np.array([[1.0, 2.0]])
+    out = np.array([[1.0, 5.0, 2.0, 7.0]])
+    with pytest.raises(ValueError):
+        symnmf.symnmf(W, H, out=out[:, ::2], max_iter=1)
+    np.testing.assert_array_equal(out, [[1.0, 5.0, 2.0, 7.0]])
+    contiguous = np.zeros((1, 2))
+    assert symnmf.symnmf(W, H, out=contiguous, max_iter=1) is contiguous
+    np.testing.assert_allclose(contiguous, [[0.8, 1.6]])
+
+
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15)])
+def test_out_of_core_matches_dense(number, k, tmp_path):
+    X = load_input(number)
+    W = symnmf.norm(X)
+    H0 = initialize_H(W, k, 1234)
+    np.testing.assert_array_equal(symnmf.symnmf_out_of_core(X, H0, scratch=str(tmp_path)), symnmf.symnmf(W, H0))
+    assert list(tmp_path.iterdir()) == []  # The scratch file is unlinked
+
+
+@pytest.mark.parametrize("solver", ["multiplicative", "momentum", "panls"])
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15)])
+def test_matrix_free_matches_dense(number, k, solver):
+    X = load_input(number)
+    W = symnmf.norm(X)
+    H0 = initialize_H(W, k, 1234)
+    np.testing.assert_array_equal(symnmf.symnmf_matrix_free(X, H0, solver=solver), symnmf.symnmf(W, H0, solver=solver))
+
+
+@pytest.mark.parametrize("solver", ["momentum", "panls"])
+@pytest.mark.parametrize("number, k", [(1, 3), (2, 7), (3, 15), (3, 4)])
+def test_accelerated_solvers_not_worse(number, k, solver):
+    W = symnmf.norm(load_input(number))
+    H0 = initialize_H(W, k, 1234)
+    objectives = {}
+    for name in ("multiplicative", solver):  # The same budget of updates for both
+        H = symnmf.symnmf(W, H0, solver=name, tol=0, max_iter=20)
+        assert H.min() >= 0
+        objectives[name] = np.linalg.norm(W - H @ H.T)
+    assert objectives[solver] <= objectives["multiplicative"]
+
+
+STATS_KEYS = {"seconds", "flops", "gflops", "bytes", "iterations", "deltas"}
+PHASES = {"load", "similarity", "degree", "normalize", "symnmf", "output"}
+
+
+def test_stats_are_per_call():
+    X = load_input(2)
+    W = symnmf.norm(X)
+    H0 = initialize_H(W, 7, 1234)
+    H, stats = symnmf.symnmf(W, H0, tol=0, max_iter=5, stats=True)
+    np.testing.assert_array_equal(H, symnmf.symnmf(W, H0, tol=0, max_iter=5))
+    np.testing.assert_array_equal(symnmf.norm(X, stats=True)[0], W)
+    best, runs, restart_stats = symnmf.symnmf_restarts(W, 3, restarts=3, stats=True)
+    Hs, sweep_runs, sweep_stats = symnmf.symnmf_sweep(X, 2, 4, stats=True)
+    if stats is None:  # Built without SYMNMF_STATS=1
+        assert restart_stats is None and sweep_stats is None
+        pytest.skip("the symnmf extension is built without statistics")
+    assert set(stats) == STATS_KEYS
+    assert all(set(stats[name]) == PHASES for name in ("seconds", "flops", "gflops", "bytes"))
+    assert stats["iterations"] == 5 and len(stats["deltas"]) == 5  # Nothing carried over from other calls
+    assert stats["flops"]["symnmf"] > 0 and stats["flops"]["similarity"] == 0
+    assert symnmf.symnmf(W, H0, tol=0, max_iter=5, stats=True)[1]["iterations"] == 5
+    assert symnmf.norm(X, stats=True)[1]["flops"]["similarity"] > 0
+    assert restart_stats["iterations"] == runs["iterations"].sum()  # The parallel runs count into their call
+    assert sweep_stats["iterations"] == sweep_runs["iterations"].sum()
+
+
+@pytest.mark.parametrize("number, k", [(1, 3), (3, 4)])
+def test_restarts_match_single_runs(number, k):
+    W = symnmf.norm(load_input(number))
+    best, runs = symnmf.symnmf_restarts(W, k, restarts=4, seed=99)
+    singles = [symnmf.symnmf(W, initialize_H(W, k, 99 + r)) for r in range(4)]
+    objectives = [np.linalg.norm(W - H @ H.T) for H in singles]
+    np.testing.assert_array_equal(runs["seed"], [99, 100, 101, 102])
+    np.testing.assert_allclose(runs["objective"], objectives, rtol=1e-9)
+    assert runs["best"] == np.argmin(objectives)
+    np.testing.assert_allclose(best, singles[runs["best"]], rtol=0, atol=1e-12)
+
+
+@pytest.mark.parametrize("warm_start", [False, True])
+def test_sweep_matches_single_runs(warm_start):
+    X = load_input(3)
+    W = symnmf.norm(X)
+    Hs, runs = symnmf.symnmf_sweep(X, 2, 5, warm_start=warm_start, seed=42)
+    np.testing.assert_array_equal(runs["k"], [2, 3, 4, 5])
+    for j, k in enumerate(range(2, 6)):
+        H0 = initialize_H(W, k, 42)
+        if warm_start and j:  # The previous k's H plus one column seeded with seed + k
+            np.random.seed(42 + k)
+            H0 = np.hstack([Hs[j - 1], np.random.uniform(0, 2 * np.sqrt(np.mean(W) / k), (W.shape[0], 1))])
+        H = symnmf.symnmf(W, H0)
+        np.testing.assert_allclose(Hs[j], H, rtol=0, atol=1e-12)
+        assert runs["objective"][j] == pytest.approx(np.linalg.norm(W - H @ H.T), rel=1e-9)
+
+
+def numpy_silhouette(X, labels):
+    """sklearn's silhouette_score written out in NumPy (singleton clusters score 0). Ret: the mean coefficient."""
+    distances = np.linalg.norm(X[:, None, :] - X[None, :, :], axis=2)
+    clusters = np.unique(labels)
+    scores = np.zeros(len(X))
+    for i in range(len(X)):
+        own = labels == labels[i]
+        if own.sum() == 1:
+            continue
+        a = distances[i, own].sum() / (own.sum() - 1)
+        b = min(distances[i, labels == c].mean() for c in clusters if c != labels[i])
+        scores[i] = (b - a) / max(a, b)
+    return scores.mean()
+
+
+def silhouette_labelings(X):
+    """Ret: a few labelings of X to score: round robin, k-means and one with a singleton cluster."""
+    singleton = np.arange(len(X)) % 3
+    singleton[0] = 3
+    return [np.arange(len(X)) % 4, symnmf.kmeans(X, 5), singleton]
+
+
+@pytest.mark.parametrize("number", [1, 2, 3])
+def test_silhouette_matches_numpy(number):
+    X = load_input(number)
+    labelings = silhouette_labelings(X)
+    expected = [numpy_silhouette(X, labels) for labels in labelings]
+    assert [symnmf.silhouette(X, labels) for labels in labelings] == pytest.approx(expected, rel=1e-9)
+    np.testing.assert_allclose(symnmf.silhouette(X, labelings), expected, rtol=1e-9)
+
+
+@pytest.mark.parametrize("number", [1, 2, 3])
+def test_silhouette_matches_sklearn(number):
+    metrics = pytest.importorskip("sklearn.metrics")
+    X = load_input(number)
+    for labels in silhouette_labelings(X):
+        assert symnmf.silhouette(X, labels) == pytest.approx(metrics.silhouette_score(X, labels), rel=1e-9)
+
+
+def test_silhouette_sparse_labels_match_dense():
+    X = load_input(2)
+    dense = symnmf.kmeans(X, 4)
+    sparse = np.array([0, 50_000_000, 7, 2**31 - 2])[dense]
+    expected = numpy_silhouette(X, dense)
+    assert symnmf.silhouette(X, sparse) == pytest.approx(expected, rel=1e-9)
+    np.testing.assert_allclose(symnmf.silhouette(X, [sparse, dense]), [expected, expected], rtol=1e-9)
+
+
+@pytest.mark.parametrize("clusters", ["one", "n"])
+def test_silhouette_needs_2_to_n_minus_1_clusters(clusters):
+    X = load_input(1)
+    labels = np.full(len(X), 5) if clusters == "one" else np.arange(len(X)) * 3
+    with pytest.raises(ValueError):
+        symnmf.silhouette(X, labels)
+    with pytest.raises(ValueError):
+        symnmf.silhouette(X, [np.arange(len(X)) % 2, labels])
+    assert symnmf.silhouette(X, np.minimum(np.arange(len(X)), len(X) - 2)) == pytest.approx(
+        numpy_silhouette(X, np.minimum(np.arange(len(X)), len(X) - 2)), rel=1e-9)
+
+
+def test_silhouette_rejects_bad_labels():
+    X = load_input(1)
+    labels = np.arange(len(X)) % 3
+    for dtype in (np.int8, np.uint16, np.uint64):
+        assert symnmf.silhouette(X, labels.astype(dtype)) == pytest.approx(symnmf.silhouette(X, labels))
+    for bad in (labels.astype(float), labels.astype(bool)):
+        with pytest.raises(TypeError):
+            symnmf.silhouette(X, bad)
+    for bad in (-labels, labels * 2**40, np.where(labels == 0, np.uint64(2**63 + 5), labels.astype(np.uint64))):
+        with pytest.raises(ValueError):
+            symnmf.silhouette(X, bad)
+
+
+@pytest.mark.parametrize("number, k", [(1, 2), (1, 3), (2, 7), (3, 4), (3, 15)])
+def test_kmeans_matches_python_kmeans(number, k):
+    kmeans = pytest.importorskip("kmeans")
+    file_name = os.path.join(TESTS_DIR, f"input_{number}.txt")
+    expected = kmeans.k_means(kmeans.get_data(file_name), k)  # What analysis.py used before symnmf.kmeans
+    labels = symnmf.kmeans(np.loadtxt(file_name, delimiter=","), k)
+    assert labels.dtype == np.int32
+    assert labels.tolist() == expected